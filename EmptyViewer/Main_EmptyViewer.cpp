@@ -1,27 +1,430 @@
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h> //   ޸ 
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <iostream>
 #include <vector>
 #include <cmath>
 #include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <xmmintrin.h>
 
+#include <GL/glew.h> // PBO ؽó ε (gl.h  ؾ )
 #define GLFW_INCLUDE_GLU
 #define GLFW_DLL
 #include <GLFW/glfw3.h>
+#define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
 using namespace glm;
 
 int Width = 512;  // ̹ ػ x
 int Height = 512; // ̹ ػ y
-std::vector<vec3> OutputImage;
+
+// Framebuffer Ŭ: Ӱ â ũ  ̿ ϴ ̸ Ҵ ȼ .
+//  (stride) 4ȼ(48Ʈ)  ߸, ʿ ũⰡ  뷮 Ŭ  ٽ Ҵմϴ.
+class Framebuffer {
+public:
+    int width, height;
+    int stride; //   ȼ  (width ̻)
+
+    Framebuffer() : width(0), height(0), stride(0) {}
+
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        stride = (w + 3) & ~3;
+        size_t needed = static_cast<size_t>(stride) * h;
+        if (needed > pixels.size()) {
+            pixels.resize(needed);
+        }
+    }
+
+    void clear(const vec3& color) {
+        std::fill(pixels.begin(), pixels.begin() + static_cast<size_t>(stride) * height, color);
+    }
+
+    vec3& at(int x, int y) {
+        return pixels[static_cast<size_t>(y) * stride + x];
+    }
+    const vec3& at(int x, int y) const {
+        return pixels[static_cast<size_t>(y) * stride + x];
+    }
+
+    vec3* data() {
+        return pixels.empty() ? nullptr : &pixels[0];
+    }
+    const vec3* data() const {
+        return pixels.empty() ? nullptr : &pixels[0];
+    }
+
+private:
+    std::vector<vec3> pixels;
+};
+
+Framebuffer OutputImage;  //   ( )
+Framebuffer DisplayImage; //  ΰ  ڵ ģ ȭ ¿ 
+
+// -------------------------------------------------
+//  
+//
+// RENDER_STATS 1  ϸ  , ⺻   ˻ , BVH  湮   īͿ
+// Ÿ  ܰ躰 ð ð ϴ. īʹ 帶  ιǷ ߰ſ ο  ̳ 
+// ,  尡   ڿ ջմϴ. 0̸(⺻) STAT_ADD STAT_SCOPE   Ǿ
+//  ڵ尡   ʽϴ.
+#ifndef RENDER_STATS
+#define RENDER_STATS 0
+#endif
+
+enum StatCounter {
+    STAT_PRIMARY_RAYS,   // ī޶  (Ƽϸ ǥ )
+    STAT_SHADOW_RAYS,    // ׸ 
+    STAT_SHADED_HITS,    //  ó 
+    STAT_SPHERE_TESTS,   // -  ˻ (  ŭ)
+    STAT_PLANE_TESTS,    // -  ˻
+    STAT_TRIANGLE_TESTS, // -ﰢ  ˻
+    STAT_BVH_NODES,      // BVH  湮 ( ȸ  1)
+    STAT_COUNT
+};
+
+const char* const STAT_NAMES[STAT_COUNT] = {
+    "primary_rays", "shadow_rays", "shaded_hits", "sphere_tests", "plane_tests", "triangle_tests", "bvh_nodes"
+};
+
+#if RENDER_STATS
+// TraceEvent ü: Chrome trace_event Ϸ ̺Ʈ ϳ (ð ũ)
+struct TraceEvent {
+    const char* name;
+    double start;
+    double duration;
+    int x, y; // Ÿ ̺Ʈ Ÿ ġ ( ۿ -1)
+};
+
+// ThreadStats ü:  ϳ  īͿ ̺Ʈ.  常 ϴ.
+struct ThreadStats {
+    int id;
+    bool main_thread;
+    uint64_t counters[STAT_COUNT];
+    std::vector<TraceEvent> events;
+};
+
+// StatsRegistry Ŭ: 庰 踦 մϴ.  ó 踦       ϵ˴ϴ.
+// ۾ 尡    ִٰ   ջ˴ϴ.
+class StatsRegistry {
+public:
+    StatsRegistry() : epoch(std::chrono::steady_clock::now()), main_thread(std::this_thread::get_id()) {}
+
+    ThreadStats* registerThread() {
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.push_back(std::unique_ptr<ThreadStats>(new ThreadStats()));
+        ThreadStats* stats = threads.back().get();
+        stats->id = static_cast<int>(threads.size());
+        stats->main_thread = std::this_thread::get_id() == main_thread;
+        std::fill(stats->counters, stats->counters + STAT_COUNT, 0);
+        return stats;
+    }
+
+    // α׷    ð (ũ)
+    double now() const {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    //  尡   ڿ ȣؾ մϴ.
+    const std::vector<std::unique_ptr<ThreadStats>>& all() const {
+        return threads;
+    }
+
+private:
+    std::chrono::steady_clock::time_point epoch;
+    std::thread::id main_thread; //  ü̹Ƿ main 忡 
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadStats>> threads;
+};
+
+StatsRegistry RenderStatsRegistry;
+
+inline ThreadStats& threadStats() {
+    thread_local ThreadStats* stats = RenderStatsRegistry.registerThread();
+    return *stats;
+}
+
+// StatScope Ŭ:  Ҹ ð   ̺Ʈ մϴ.
+class StatScope {
+public:
+    explicit StatScope(const char* name, int x = -1, int y = -1) : name(name), x(x), y(y), start(RenderStatsRegistry.now()) {}
+
+    ~StatScope() {
+        TraceEvent event = { name, start, RenderStatsRegistry.now() - start, x, y };
+        threadStats().events.push_back(event);
+    }
+
+private:
+    const char* name;
+    int x, y;
+    double start;
+};
+
+//   ī͸ ջ {"̸": , ...} · ϴ.
+void writeStatCounters(std::ostream& out, const uint64_t* counters) {
+    out << "{";
+    for (int k = 0; k < STAT_COUNT; ++k) {
+        out << (k ? ", " : "") << "\"" << STAT_NAMES[k] << "\": " << counters[k];
+    }
+    out << "}";
+}
+
+// 踦 JSON ϴ: ü ī, 庰 īͿ Ÿ ð, ܰ躰 ð հ, Ÿ ð .
+//  尡   ڿ ȣؾ մϴ.
+bool writeStatsJSON(const std::string& path) {
+    uint64_t totals[STAT_COUNT] = {};
+    std::vector<std::pair<const char*, double>> stages; // ̸ ð հ (ũ)
+    double tile_min = INFINITY, tile_max = 0.0, tile_total = 0.0;
+    long long tile_count = 0;
+    for (const auto& thread : RenderStatsRegistry.all()) {
+        for (int k = 0; k < STAT_COUNT; ++k) {
+            totals[k] += thread->counters[k];
+        }
+        for (const TraceEvent& event : thread->events) {
+            if (std::strcmp(event.name, "tile") == 0) {
+                tile_min = std::min(tile_min, event.duration);
+                tile_max = std::max(tile_max, event.duration);
+                tile_total += event.duration;
+                ++tile_count;
+                continue;
+            }
+            size_t k = 0;
+            while (k < stages.size() && std::strcmp(stages[k].first, event.name) != 0) {
+                ++k;
+            }
+            if (k == stages.size()) {
+                stages.push_back(std::make_pair(event.name, 0.0));
+            }
+            stages[k].second += event.duration;
+        }
+    }
+
+    std::ofstream out(path.c_str());
+    if (!out) {
+        std::cerr << "Cannot open " << path << " for writing" << std::endl;
+        return false;
+    }
+    out << "{\n  \"counters\": ";
+    writeStatCounters(out, totals);
+    out << ",\n  \"stages_ms\": {";
+    for (size_t k = 0; k < stages.size(); ++k) {
+        out << (k ? ", " : "") << "\"" << stages[k].first << "\": " << stages[k].second * 1e-3;
+    }
+    out << "},\n  \"tiles\": {\"count\": " << tile_count;
+    if (tile_count > 0) {
+        out << ", \"min_ms\": " << tile_min * 1e-3 << ", \"mean_ms\": " << tile_total / tile_count * 1e-3 << ", \"max_ms\": " << tile_max * 1e-3;
+    }
+    out << "},\n  \"threads\": [\n";
+    const auto& threads = RenderStatsRegistry.all();
+    for (size_t k = 0; k < threads.size(); ++k) {
+        double busy = 0.0;
+        long long tiles = 0;
+        for (const TraceEvent& event : threads[k]->events) {
+            if (std::strcmp(event.name, "tile") == 0) {
+                busy += event.duration;
+                ++tiles;
+            }
+        }
+        out << "    {\"id\": " << threads[k]->id << ", \"tiles\": " << tiles << ", \"tile_ms\": " << busy * 1e-3 << ", \"counters\": ";
+        writeStatCounters(out, threads[k]->counters);
+        out << "}" << (k + 1 < threads.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+//  ̺Ʈ Chrome trace_event (chrome://tracing Ǵ Perfetto ) ϴ.
+bool writeChromeTrace(const std::string& path) {
+    std::ofstream out(path.c_str());
+    if (!out) {
+        std::cerr << "Cannot open " << path << " for writing" << std::endl;
+        return false;
+    }
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    for (const auto& thread : RenderStatsRegistry.all()) {
+        out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread->id
+            << ", \"args\": {\"name\": \"" << (thread->main_thread ? "main" : "worker") << " " << thread->id << "\"}}";
+        first = false;
+        for (const TraceEvent& event : thread->events) {
+            out << ",\n{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << thread->id
+                << ", \"ts\": " << event.start << ", \"dur\": " << event.duration;
+            if (event.x >= 0) {
+                out << ", \"args\": {\"x\": " << event.x << ", \"y\": " << event.y << "}";
+            }
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
+
+#define STAT_ADD(counter, n) (threadStats().counters[counter] += static_cast<uint64_t>(n))
+#define STAT_SCOPE(...) StatScope stat_scope(__VA_ARGS__)
+#else
+#define STAT_ADD(counter, n) ((void)0)
+#define STAT_SCOPE(...) ((void)0)
+#endif
+
 // -------------------------------------------------
 
 // Ray Ŭ:  ǥմϴ.
+//  (tmin, tmax)  ȿ ãϴ.    ã Լ  ã  tmax  Ÿ
+// ̹Ƿ, Ŀ ˻ϴ  BVH  ݱ ã  ָ ٷ ǳʶݴϴ.
 class Ray {
 public:
-    vec3 origin;     //  
-    vec3 direction;  //   
+    vec3 origin;        //  
+    vec3 direction;     //   
+    float tmin, tmax;   //  ã  (  )
+    vec3 inv_direction; // 1 / direction (slab ׽Ʈ)
+    int sign[3];        // direction  ̸ 1 (slab ׽Ʈ    )
+
+    Ray() {} // lightSample  ä ڸ
+
+    Ray(const vec3& origin, const vec3& direction, float tmin = 0.0f, float tmax = INFINITY)
+        : origin(origin), direction(direction), tmin(tmin), tmax(tmax), inv_direction(1.0f / direction) {
+        sign[0] = inv_direction.x < 0.0f;
+        sign[1] = inv_direction.y < 0.0f;
+        sign[2] = inv_direction.z < 0.0f;
+    }
+};
+
+// ׸   ǥ鿡 ٽ ε ʵ    Ÿ ׸  tmin
+const float SHADOW_EPSILON = 0.001f;
+
+// RayPacket4 ü:  2x2 ȼ  4 SSE κ   SoA .
+// κ  Ʒ  tmin̰,    Լ PacketHit::t ٿ ϴ.
+struct RayPacket4 {
+    __m128 ox, oy, oz; // κ 
+    __m128 dx, dy, dz; // κ  
+    __m128 tmin;       // κ  Ʒ 
+
+    RayPacket4() {} // SoA ť   о ä 
+
+    explicit RayPacket4(const Ray* rays) {
+        ox = _mm_setr_ps(rays[0].origin.x, rays[1].origin.x, rays[2].origin.x, rays[3].origin.x);
+        oy = _mm_setr_ps(rays[0].origin.y, rays[1].origin.y, rays[2].origin.y, rays[3].origin.y);
+        oz = _mm_setr_ps(rays[0].origin.z, rays[1].origin.z, rays[2].origin.z, rays[3].origin.z);
+        dx = _mm_setr_ps(rays[0].direction.x, rays[1].direction.x, rays[2].direction.x, rays[3].direction.x);
+        dy = _mm_setr_ps(rays[0].direction.y, rays[1].direction.y, rays[2].direction.y, rays[3].direction.y);
+        dz = _mm_setr_ps(rays[0].direction.z, rays[1].direction.z, rays[2].direction.z, rays[3].direction.z);
+        tmin = _mm_setr_ps(rays[0].tmin, rays[1].tmin, rays[2].tmin, rays[3].tmin);
+    }
+
+    //  ϳ  (   INFINITY̹Ƿ ȣ  PacketHit::t )
+    Ray ray(int lane) const {
+        float x[4], y[4], z[4], u[4], v[4], w[4], lo[4];
+        _mm_storeu_ps(x, ox); _mm_storeu_ps(y, oy); _mm_storeu_ps(z, oz);
+        _mm_storeu_ps(u, dx); _mm_storeu_ps(v, dy); _mm_storeu_ps(w, dz);
+        _mm_storeu_ps(lo, tmin);
+        return Ray(vec3(x[lane], y[lane], z[lane]), vec3(u[lane], v[lane], w[lane]), lo[lane]);
+    }
+};
+
+// ũ   a,   b ϴ (SSE2 blendv ).
+inline __m128 select4(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+//  ϳ  4  Ŀ: t > packet.tmin  ִ  ũ  t ݴϴ.
+inline __m128 intersectSphere4(const RayPacket4& packet, float cx, float cy, float cz, float radius, __m128& t) {
+    __m128 ocx = _mm_sub_ps(packet.ox, _mm_set1_ps(cx));
+    __m128 ocy = _mm_sub_ps(packet.oy, _mm_set1_ps(cy));
+    __m128 ocz = _mm_sub_ps(packet.oz, _mm_set1_ps(cz));
+    __m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(packet.dx, packet.dx), _mm_mul_ps(packet.dy, packet.dy)), _mm_mul_ps(packet.dz, packet.dz));
+    __m128 b = _mm_mul_ps(_mm_set1_ps(2.0f), _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, packet.dx), _mm_mul_ps(ocy, packet.dy)), _mm_mul_ps(ocz, packet.dz)));
+    __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz)), _mm_set1_ps(radius * radius));
+    __m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(4.0f), a), c));
+    __m128 valid = _mm_cmpge_ps(discriminant, _mm_setzero_ps());
+    if (_mm_movemask_ps(valid) == 0) {
+        return valid;
+    }
+    __m128 root = _mm_sqrt_ps(_mm_max_ps(discriminant, _mm_setzero_ps()));
+    __m128 neg_b = _mm_sub_ps(_mm_setzero_ps(), b);
+    __m128 two_a = _mm_mul_ps(_mm_set1_ps(2.0f), a);
+    __m128 t0 = _mm_div_ps(_mm_sub_ps(neg_b, root), two_a);
+    __m128 t1 = _mm_div_ps(_mm_add_ps(neg_b, root), two_a);
+    t = select4(_mm_cmple_ps(t0, packet.tmin), t1, t0);
+    return _mm_and_ps(valid, _mm_cmpgt_ps(t, packet.tmin));
+}
+
+class Surface;
+class Instance;
+
+// Hit ü:  ϳ    .
+// Ϲ ǥ  surface,  (SphereSet)   sphere  ȣ ϴ.
+// ﰢ ޽ó  ⺻   ǥ prim  ⺻  ȣ ϴ.
+// νϽ ȿ  instance  νϽ,  ʵ忡     ϴ.
+struct Hit {
+    float t;
+    const Surface* surface;
+    int sphere;
+    int prim;
+    const Instance* instance;
+
+    Hit() : t(INFINITY), surface(nullptr), sphere(-1), prim(-1), instance(nullptr) {}
+
+    bool valid() const {
+        return surface != nullptr || sphere >= 0;
+    }
+};
 
-    Ray(const vec3& origin, const vec3& direction) : origin(origin), direction(direction) {}
+// PacketHit ü:   κ     (Hit SoA )
+struct PacketHit {
+    __m128 t;
+    const Surface* surface[4];
+    int sphere[4];
+    int prim[4];
+    const Instance* instance[4];
+
+    PacketHit() : t(_mm_set1_ps(INFINITY)) {
+        for (int lane = 0; lane < 4; ++lane) {
+            surface[lane] = nullptr;
+            sphere[lane] = -1;
+            prim[lane] = -1;
+            instance[lane] = nullptr;
+        }
+    }
+
+    Hit lane(int k) const {
+        float lanes[4];
+        _mm_storeu_ps(lanes, t);
+        Hit hit;
+        hit.t = lanes[k];
+        hit.surface = surface[k];
+        hit.sphere = sphere[k];
+        hit.prim = prim[k];
+        hit.instance = instance[k];
+        return hit;
+    }
 };
 
 // Camera Ŭ: ī޶ ǥմϴ.
@@ -36,10 +439,15 @@ public:
         : eye(eye), u(u), v(v), w(w), l(l), r(r), b(b), t(t), d(d) {
     }
 
-    // ȼ ǥ   ϴ Լ
+    // ȼ ǥ   ϴ Լ (ȼ ߽)
     Ray getRay(float ix, float iy) const {
-        float ndc_x = (ix + 0.5f) / Width;
-        float ndc_y = (iy + 0.5f) / Height;
+        return getSampleRay(ix + 0.5f, iy + 0.5f);
+    }
+
+    // ̹   ǥ  ϴ Լ. ȼ (i, j) [i, i + 1) x [j, j + 1) Դϴ.
+    Ray getSampleRay(float x, float y) const {
+        float ndc_x = x / Width;
+        float ndc_y = y / Height;
         float screen_x = l + (r - l) * ndc_x;
         float screen_y = b + (t - b) * ndc_y;
 
@@ -48,49 +456,274 @@ public:
     }
 };
 
+//  ī޶    (ĳ    ȿ Ȯ  )
+inline bool sameCamera(const Camera& a, const Camera& b) {
+    return a.eye == b.eye && a.u == b.u && a.v == b.v && a.w == b.w
+        && a.l == b.l && a.r == b.r && a.b == b.b && a.t == b.t && a.d == b.d;
+}
+
 // Material Ŭ: ǥ  Ӽ ǥմϴ.
+//     . 鿡      ΰ,  ó 𵨺 ϵ Լ б
+//  0  (ݻ pow ) ׿  б⸦ ǳʶݴϴ.
+enum class ShadingModel {
+    Ambient,   // kd = ks = 0:   ʰ ׸  
+    Lambert,   // ks = 0: Ȯ и
+    BlinnPhong // Ȯ + ݻ
+};
+
 class Material {
 public:
     vec3 ka; // Ambient ݻ  (ֺ)
     vec3 kd; // Diffuse ݻ  (ݻ)
     vec3 ks; // Specular ݻ  (ݻ)
     float specular_power; // Specular power (ݻ )
+    ShadingModel model;   // Scene::addMaterial selectModel() 
 
     Material(const vec3& ka, const vec3& kd, const vec3& ks, float specular_power)
-        : ka(ka), kd(kd), ks(ks), specular_power(specular_power) {
+        : ka(ka), kd(kd), ks(ks), specular_power(specular_power), model(ShadingModel::BlinnPhong) {
+    }
+
+    // 0 ƴ  ϴ  ܼ 
+    ShadingModel selectModel() const {
+        bool diffuse = kd != vec3(0.0f);
+        bool specular = ks != vec3(0.0f);
+        return specular ? ShadingModel::BlinnPhong : diffuse ? ShadingModel::Lambert : ShadingModel::Ambient;
+    }
+};
+
+// Light Ŭ:  Ǵ ƮƮ.
+// range 0 ũ range    ʰ, ʿ (1 - (d / range)^4)^2 â ε巴 0 پϴ.
+// range 0̸ Ÿ ϰ  ü ϴ (   ).
+// ƮƮ    ִ ̰ ٱ  0 ˴ϴ.
+class Light {
+public:
+    vec3 position;
+    vec3 color;      // Ȯ, ݻ п ϴ 
+    float range;     //   (0̸ )
+    vec3 direction;  // ƮƮ  ( )
+    float cos_inner; //    ڻ
+    float cos_outer; //  ٱ  ڻ (-1 ϸ )
+
+    explicit Light(const vec3& position)
+        : position(position), color(1.0f), range(0.0f), direction(0.0f, -1.0f, 0.0f), cos_inner(-2.0f), cos_outer(-2.0f) {
+    }
+
+    //   ϴ   light_dir Ÿ distance  [0, 1]
+    float attenuation(const vec3& light_dir, float distance) const {
+        float falloff = 1.0f;
+        if (range > 0.0f) {
+            float x = distance / range;
+            x *= x;
+            float window = std::max(0.0f, 1.0f - x * x);
+            falloff = window * window;
+        }
+        if (cos_outer > -1.0f) {
+            falloff *= smoothstep(cos_outer, cos_inner, -dot(light_dir, direction));
+        }
+        return falloff;
+    }
+
+    // point   ̸ point  ϴ  Ϳ Ÿ ϰ true ȯմϴ.
+    // Ÿ   κ  ̹Ƿ  ϱ  Ÿ   Ÿϴ.
+    bool reaches(const vec3& point, vec3& light_dir, float& distance) const {
+        vec3 to_light = position - point;
+        float distance_sq = dot(to_light, to_light);
+        if (range > 0.0f && distance_sq >= range * range) {
+            return false;
+        }
+        distance = sqrt(distance_sq);
+        light_dir = to_light * (1.0f / distance); // normalize(to_light)  
+        return true;
+    }
+};
+
+// ShadingPoint ü:  ó ʿ 1   ( ٽ  ʰ  ٽ   )
+struct ShadingPoint {
+    vec3 position;
+    vec3 normal;
+    int material_id;
+    float depth; //   Ÿ t
+};
+
+// LightList ü:  ó   ȣ  (LightGrid Ÿ  Ŵ)
+struct LightList {
+    const int* ids;
+    int count;
+};
+
+// AABB ü:     (BVH  ǥ )
+struct AABB {
+    vec3 lo, hi;
+
+    AABB() : lo(INFINITY), hi(-INFINITY) {}
+    AABB(const vec3& lo, const vec3& hi) : lo(lo), hi(hi) {}
+
+    void expand(const vec3& p) {
+        lo = min(lo, p);
+        hi = max(hi, p);
+    }
+    void expand(const AABB& box) {
+        lo = min(lo, box.lo);
+        hi = max(hi, box.hi);
+    }
+    vec3 centroid() const {
+        return (lo + hi) * 0.5f;
+    }
+    float area() const { // SAH   ǥ ( ڴ 0)
+        vec3 e = max(hi - lo, vec3(0.0f));
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+
+    // Slab ׽Ʈ:  [ray.tmin, ray.tmax]  ȿ ڿ   Ÿ tnear ݴϴ.
+    //  ȣ Ʈ ึ    ٷ  ະ min/max  ʽϴ.
+    bool intersect(const Ray& ray, float& tnear) const {
+        float tx0 = ((ray.sign[0] ? hi.x : lo.x) - ray.origin.x) * ray.inv_direction.x;
+        float tx1 = ((ray.sign[0] ? lo.x : hi.x) - ray.origin.x) * ray.inv_direction.x;
+        float ty0 = ((ray.sign[1] ? hi.y : lo.y) - ray.origin.y) * ray.inv_direction.y;
+        float ty1 = ((ray.sign[1] ? lo.y : hi.y) - ray.origin.y) * ray.inv_direction.y;
+        float tz0 = ((ray.sign[2] ? hi.z : lo.z) - ray.origin.z) * ray.inv_direction.z;
+        float tz1 = ((ray.sign[2] ? lo.z : hi.z) - ray.origin.z) * ray.inv_direction.z;
+        tnear = std::max(std::max(tx0, ty0), std::max(tz0, ray.tmin));
+        float tfar = std::min(std::min(tx1, ty1), std::min(tz1, ray.tmax));
+        return tnear <= tfar;
     }
+
+    //  4  slab ׽Ʈ: [packet.tmin, tmax]  ڿ   ũ κ  Ÿ ݴϴ.
+    __m128 intersect4(const RayPacket4& packet, const __m128* inv_dir, __m128 tmax, __m128& tnear) const {
+        __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(lo.x), packet.ox), inv_dir[0]);
+        __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(hi.x), packet.ox), inv_dir[0]);
+        __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(lo.y), packet.oy), inv_dir[1]);
+        __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(hi.y), packet.oy), inv_dir[1]);
+        __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(lo.z), packet.oz), inv_dir[2]);
+        __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(hi.z), packet.oz), inv_dir[2]);
+        tnear = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)), _mm_max_ps(_mm_min_ps(t0z, t1z), packet.tmin));
+        __m128 tfar = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)), _mm_min_ps(_mm_max_ps(t0z, t1z), tmax));
+        return _mm_cmple_ps(tnear, tfar);
+    }
+};
+
+// EditRegion ü:   ٲ    (  ġ   )
+struct EditRegion {
+    AABB box;
+    bool shadows; // ׸ڵ ٲ ( ٲ  false)
 };
 
 // Surface Ŭ:  ǥ ŬԴϴ.
 class Surface {
 public:
+    virtual ~Surface() {}
+
+    //   (ray.tmin, ray.tmax)      t  true ȯմϴ.
     virtual bool intersect(const Ray& ray, float& t) const = 0;
-    virtual vec3 getNormal(const vec3& point) const = 0;
-    virtual Material getMaterial() const = 0; // ǥ   Լ
+    //   ϴ Լ. prim  ⺻  ȣ(Hit::prim)̸   ǥ մϴ.
+    virtual vec3 getNormal(const vec3& point, int prim) const = 0;
+    virtual int getMaterialId() const = 0; // ǥ  ȣ(Scene::materials ε)  Լ
+    // ǥ  ڸ ϴ Լ. ó  ǥ false ȯ BVH ۿ  ˻մϴ.
+    virtual bool getBounds(AABB& box) const = 0;
+
+    //   ȿ   ray.tmax  Ÿ ̰ hit   true ȯմϴ.
+    // ⺻  intersect ϸ,  ⺻   ǥ hit.prim ä쵵 մϴ.
+    virtual bool intersectClosest(Ray& ray, Hit& hit) const {
+        float t;
+        if (intersect(ray, t)) {
+            ray.tmax = t;
+            hit.t = t;
+            hit.surface = this;
+            hit.sphere = -1;
+            hit.prim = -1;
+            hit.instance = nullptr;
+            return true;
+        }
+        return false;
+    }
+
+    // ׸    Լ:    ϳ  true.
+    //   t ʿ Ƿ  Ŭ  ΰ ϵ մϴ.
+    virtual bool occluded(const Ray& ray) const {
+        float t;
+        return intersect(ray, t);
+    }
+
+    //    Լ: ݱ hit.t   ִ   մϴ.
+    // ⺻  θ intersect ȣϸ,   SSE Ŀη մϴ.
+    virtual void intersect4(const RayPacket4& packet, PacketHit& hit) const {
+        float closest[4], masks[4];
+        _mm_storeu_ps(closest, hit.t);
+        for (int lane = 0; lane < 4; ++lane) {
+            Ray ray = packet.ray(lane);
+            ray.tmax = closest[lane];
+            float t;
+            bool lane_hit = intersect(ray, t);
+            closest[lane] = lane_hit ? t : closest[lane];
+            masks[lane] = lane_hit ? 1.0f : 0.0f;
+        }
+        storeHits4(_mm_cmpgt_ps(_mm_loadu_ps(masks), _mm_setzero_ps()), _mm_loadu_ps(closest), hit);
+    }
+
+protected:
+    // intersect4 Ŀ  hit ũ  ο ݿմϴ.
+    void storeHits4(__m128 mask, __m128 t, PacketHit& hit) const {
+        int lanes = _mm_movemask_ps(mask);
+        if (lanes == 0) {
+            return;
+        }
+        hit.t = select4(mask, t, hit.t);
+        for (int lane = 0; lane < 4; ++lane) {
+            if (lanes & (1 << lane)) {
+                hit.surface[lane] = this;
+                hit.sphere[lane] = -1;
+                hit.prim[lane] = -1;
+                hit.instance[lane] = nullptr;
+            }
+        }
+    }
 };
 
 // Plane Ŭ:  ǥմϴ.
 class Plane : public Surface {
 public:
     float y; //  y ǥ
-    Material material; //  
+    int material_id; //   ȣ
 
-    Plane(float y, const Material& material) : y(y), material(material) {}
+    Plane(float y, int material_id) : y(y), material_id(material_id) {}
 
     bool intersect(const Ray& ray, float& t) const override {
+        STAT_ADD(STAT_PLANE_TESTS, 1);
         if (abs(ray.direction.y) < 1e-6) { //    
             return false;
         }
         t = (this->y - ray.origin.y) / ray.direction.y;
-        return t > 0; //   ⿡ ־ 
+        return t > ray.tmin && t < ray.tmax; //    ȿ ־ 
+    }
+
+    bool occluded(const Ray& ray) const override {
+        STAT_ADD(STAT_PLANE_TESTS, 1);
+        if (abs(ray.direction.y) < 1e-6) { //    
+            return false;
+        }
+        float t = (this->y - ray.origin.y) / ray.direction.y;
+        return t > ray.tmin && t < ray.tmax;
     }
 
-    vec3 getNormal(const vec3& point) const override {
+    void intersect4(const RayPacket4& packet, PacketHit& hit) const override {
+        STAT_ADD(STAT_PLANE_TESTS, 4);
+        __m128 abs_dy = _mm_max_ps(packet.dy, _mm_sub_ps(_mm_setzero_ps(), packet.dy));
+        __m128 not_parallel = _mm_cmpge_ps(abs_dy, _mm_set1_ps(1e-6f));
+        __m128 t = _mm_div_ps(_mm_sub_ps(_mm_set1_ps(this->y), packet.oy), packet.dy);
+        __m128 mask = _mm_and_ps(not_parallel, _mm_and_ps(_mm_cmpgt_ps(t, packet.tmin), _mm_cmplt_ps(t, hit.t)));
+        storeHits4(mask, t, hit);
+    }
+
+    vec3 getNormal(const vec3& point, int prim) const override {
         return vec3(0, 1, 0); //   ʹ (0, 1, 0)
     }
 
-    Material getMaterial() const override {
-        return material;
+    int getMaterialId() const override {
+        return material_id;
+    }
+
+    bool getBounds(AABB& box) const override {
+        return false; //  
     }
 };
 
@@ -99,146 +732,4595 @@ class Sphere : public Surface {
 public:
     vec3 center; //  ߽
     float radius; //  
-    Material material; //  
+    int material_id; //   ȣ
 
-    Sphere(const vec3& center, float radius, const Material& material)
-        : center(center), radius(radius), material(material) {
+    Sphere(const vec3& center, float radius, int material_id)
+        : center(center), radius(radius), material_id(material_id) {
     } //  ߽ ǥ(center) (radius) ڷ ޾ ʱȭ
 
     bool intersect(const Ray& ray, float& t) const override {
+        STAT_ADD(STAT_SPHERE_TESTS, 1);
         vec3 oc = ray.origin - center;
         float a = dot(ray.direction, ray.direction);
         float b = 2.0f * dot(oc, ray.direction);
         float c = dot(oc, oc) - radius * radius;
+        if (c > 0.0f && b > 0.0f) {
+            return false; //   ۿ ְ   ʿ 
+        }
         float discriminant = b * b - 4 * a * c; // Ǻ
 
         if (discriminant < 0) {
             return false; //    false ȯ
         }
-        //        
-        t = (-b - ::sqrt(discriminant)) / (2 * a);
-        if (t < 0) {
-            t = (-b + ::sqrt(discriminant)) / (2 * a);
-        } //   ⿡  true ȯ
-        return t > 0;
+        //          
+        float root = ::sqrt(discriminant);
+        t = (-b - root) / (2 * a);
+        if (t >= ray.tmax) {
+            return false; //   ̹  ʸӸ   ʸ
+        }
+        if (t <= ray.tmin) {
+            t = (-b + root) / (2 * a);
+        } //    ȿ  true ȯ
+        return t > ray.tmin && t < ray.tmax;
+    }
+
+    bool occluded(const Ray& ray) const override {
+        STAT_ADD(STAT_SPHERE_TESTS, 1);
+        vec3 oc = ray.origin - center;
+        float b = dot(oc, ray.direction); //  b  (2 е)
+        float c = dot(oc, oc) - radius * radius;
+        if (c > 0.0f && b > 0.0f) {
+            return false; //   ۿ ְ   ʿ 
+        }
+        float a = dot(ray.direction, ray.direction);
+        float discriminant = b * b - a * c;
+        if (discriminant < 0) {
+            return false;
+        }
+        float root = ::sqrt(discriminant); //    
+        float t0 = (-b - root) / a;
+        float t1 = (-b + root) / a;
+        return (t0 > ray.tmin && t0 < ray.tmax) || (t1 > ray.tmin && t1 < ray.tmax);
+    }
+
+    void intersect4(const RayPacket4& packet, PacketHit& hit) const override {
+        STAT_ADD(STAT_SPHERE_TESTS, 4);
+        __m128 t = hit.t;
+        __m128 mask = intersectSphere4(packet, center.x, center.y, center.z, radius, t);
+        storeHits4(_mm_and_ps(mask, _mm_cmplt_ps(t, hit.t)), t, hit);
     }
 
-    vec3 getNormal(const vec3& point) const override {
+    vec3 getNormal(const vec3& point, int prim) const override {
         return normalize(point - center);
     }
 
-    Material getMaterial() const override {
-        return material;
+    int getMaterialId() const override {
+        return material_id;
+    }
+
+    bool getBounds(AABB& box) const override {
+        box = AABB(center - vec3(radius), center + vec3(radius));
+        return true;
     }
 };
 
-// Scene Ŭ:  մϴ.
-class Scene {
+// Array Ŭ: std::vectoró  ϰų, ޸ ε    迭   Ű 迭.
+//  Ű  ϸ  ڱ ҷ մϴ.
+template <class T>
+class Array {
 public:
-    std::vector<Surface*> objects;
-    Camera camera;
-    vec3 light_pos; //  ġ
+    Array() : items(nullptr), count(0), mapped(false) {}
+    Array(const Array& other) : storage(other.begin(), other.end()) {
+        refresh();
+    }
+    Array& operator=(const Array& other) {
+        if (this != &other) {
+            storage.assign(other.begin(), other.end());
+            refresh();
+        }
+        return *this;
+    }
 
-    Scene(const Camera& camera, const vec3& light_pos) : camera(camera), light_pos(light_pos) {}
+    // ܺ ޸𸮸 ŵϴ. ޸𸮴  迭   ־ մϴ.
+    void view(const T* data, size_t n) {
+        std::vector<T>().swap(storage);
+        items = data;
+        count = n;
+        mapped = true;
+    }
 
-    void addObject(Surface* object) {
-        objects.push_back(object);
+    size_t size() const {
+        return count;
+    }
+    bool empty() const {
+        return count == 0;
+    }
+    const T* data() const {
+        return items;
+    }
+    const T* begin() const {
+        return items;
+    }
+    const T* end() const {
+        return items + count;
+    }
+    const T& operator[](size_t k) const {
+        return items[k];
+    }
+    T& operator[](size_t k) {
+        detach();
+        return storage[k];
     }
 
-    //   Լ
-    vec3 trace(const Ray& ray) const {
-        float closest_t = INFINITY;
-        Surface* closest_surface = nullptr;
-        //  ü      ü ã
-        for (Surface* object : objects) {
-            float t;
-            if (object->intersect(ray, t) && t < closest_t) {
-                closest_t = t;
-                closest_surface = object;
-            }
-        }
-        //     ü ִ°
-        if (closest_surface) {
-            vec3 intersection_point = ray.origin + ray.direction * closest_t; //  
-            vec3 normal = closest_surface->getNormal(intersection_point);     //    
-            Material material = closest_surface->getMaterial();             //  ǥ  
-            return phongShading(intersection_point, normal, material);       // Phong  ó 
-        }
-        else {
-            return vec3(0.0f, 0.0f, 0.0f); //  ȯ ()
+    void push_back(const T& value) {
+        detach();
+        storage.push_back(value);
+        refresh();
+    }
+    void resize(size_t n) {
+        detach();
+        storage.resize(n);
+        refresh();
+    }
+    void reserve(size_t n) {
+        detach();
+        storage.reserve(n);
+        refresh();
+    }
+    void clear() {
+        storage.clear();
+        refresh();
+    }
+    void swap(std::vector<T>& values) {
+        detach();
+        storage.swap(values);
+        refresh();
+    }
+
+private:
+    const T* items;
+    size_t count;
+    bool mapped;
+    std::vector<T> storage;
+
+    void refresh() {
+        items = storage.data();
+        count = storage.size();
+        mapped = false;
+    }
+    void detach() {
+        if (mapped) {
+            storage.assign(items, items + count);
+            refresh();
         }
     }
+};
 
-    // Phong  ó  Լ
-    vec3 phongShading(const vec3& point, const vec3& normal, const Material& material) const {
-        vec3 light_dir = normalize(light_pos - point); //   ϴ  
-        vec3 view_dir = normalize(-point);             //   ϴ   (ī޶  ִٰ )
-        vec3 half_vector = normalize(light_dir + view_dir); // Half-vector  (Blinn-Phong )
+// BVHNode ü: count > 0̸ prim_ids[first, first + count)  ,
+// ƴϸ ڽ 尡 nodes[first], nodes[first + 1] ִ  Դϴ.
+struct BVHNode {
+    AABB box;
+    int first;
+    int count;
+};
 
-        // Ambient  
-        vec3 ambient = material.ka;
+// BVH Ŭ:     SAH(Surface Area Heuristic)     
+class BVH {
+public:
+    Array<BVHNode> nodes;
+    Array<int> prim_ids; //  Ű  ⺻  ȣ
 
-        // Diffuse  
-        float diff = max(dot(normal, light_dir), 0.0f); //  Ϳ    
-        vec3 diffuse = material.kd * diff;
+    // max_leaf_size   SAH      ϴ.
+    void build(const std::vector<AABB>& prim_bounds, int max_leaf_size = 4) {
+        this->max_leaf_size = max_leaf_size;
+        nodes.clear();
+        prim_ids.resize(prim_bounds.size());
+        for (size_t k = 0; k < prim_ids.size(); ++k) {
+            prim_ids[k] = static_cast<int>(k);
+        }
+        if (prim_bounds.empty()) {
+            return;
+        }
+        nodes.reserve(prim_bounds.size() * 2);
+        BVHNode root;
+        root.first = 0;
+        root.count = static_cast<int>(prim_bounds.size());
+        nodes.push_back(root);
+        subdivide(0, prim_bounds, 0);
+    }
 
-        // Specular  
-        float spec = pow(max(dot(normal, half_vector), 0.0f), material.specular_power); //  Ϳ half-vector 
-        vec3 specular = material.ks * spec;
+    // Ʈ  ״ ΰ ⺻   ڰ ٲ ŭ  ڸ ٽ մϴ.
+    // ڽ  ׻ θ𺸴 ڿ Ƿ ڿ    ˴ϴ.
+    // leaf_bounds    Դϴ ( leaf_bounds[first, first + count) ).  
+    // 迭 ġ SphereSet̸,   BVHó prim_ids  ־ ˴ϴ.
+    void refit(const std::vector<AABB>& leaf_bounds) {
+        for (int node_index = static_cast<int>(nodes.size()) - 1; node_index >= 0; --node_index) {
+            BVHNode& node = nodes[node_index];
+            AABB box;
+            if (node.count > 0) {
+                for (int k = node.first; k < node.first + node.count; ++k) {
+                    box.expand(leaf_bounds[k]);
+                }
+            }
+            else {
+                box.expand(nodes[node.first].box);
+                box.expand(nodes[node.first + 1].box);
+            }
+            node.box = box;
+        }
+    }
 
-        // ׸ 
-        Ray shadow_ray(point + normal * 0.001f, light_dir); // Offset to avoid self-intersection
-        bool in_shadow = false;
-        for (Surface* object : objects) {
-            float t;
-            if (object->intersect(shadow_ray, t) && t > 0.001f) { // ׸  ٸ ü ϴ Ȯ
-                in_shadow = true;
-                break;
+    //   [ray.tmin, ray.tmax] ȿ   ִ  intersectLeaf(first, count) ȣմϴ.
+    //  ⺻  prim_ids[first, first + count)̸, intersectLeaf    ã
+    // ray.tmax ̰ ( ˻ Ź ray.tmax ٽ ), true ȯϸ ȸ  ϴ.
+    template <class IntersectLeaf>
+    void traverse(const Ray& ray, IntersectLeaf intersectLeaf) const {
+        if (nodes.empty()) {
+            return;
+        }
+        //  ݹ ray.tmax ̹Ƿ,  ʵ  纻 ΰ tmax  ٽ нϴ.
+        Ray local = ray;
+        int stack[STACK_SIZE];
+        int stack_size = 0;
+        int node_index = 0;
+        float tnear;
+        if (!nodes[0].box.intersect(local, tnear)) {
+            return;
+        }
+        for (;;) {
+            const BVHNode& node = nodes[node_index];
+            STAT_ADD(STAT_BVH_NODES, 1);
+            if (node.count > 0) {
+                if (intersectLeaf(node.first, node.count)) {
+                    return;
+                }
+                local.tmax = ray.tmax;
+            }
+            else {
+                //  ڽĺ 湮ϸ ray.tmax  پ  ڽ ǳʶ  ֽϴ.
+                int near_child = node.first;
+                int far_child = node.first + 1;
+                float t_near_child, t_far_child;
+                bool hit_near = nodes[near_child].box.intersect(local, t_near_child);
+                bool hit_far = nodes[far_child].box.intersect(local, t_far_child);
+                if (hit_near && hit_far) {
+                    if (t_far_child < t_near_child) {
+                        std::swap(near_child, far_child);
+                    }
+                    stack[stack_size++] = far_child;
+                    node_index = near_child;
+                    continue;
+                }
+                if (hit_near || hit_far) {
+                    node_index = hit_near ? near_child : far_child;
+                    continue;
+                }
             }
+            if (stack_size == 0) {
+                return;
+            }
+            node_index = stack[--stack_size];
         }
+    }
 
-        if (in_shadow) {
-            return ambient; // ׸  ambient и 
+    //   ȸ:   ϳ ڿ  ,  intersectLeaf(first, count) ȣմϴ.
+    //  ڽ  ε ּ  Ÿ մϴ.
+    template <class IntersectLeaf>
+    void traversePacket(const RayPacket4& packet, const __m128& hit_t, IntersectLeaf intersectLeaf) const {
+        if (nodes.empty()) {
+            return;
         }
-        else {
-            return ambient + diffuse + specular; // ׸ڰ ƴϸ ambient, diffuse, specular   
+        __m128 inv_dir[3] = {
+            _mm_div_ps(_mm_set1_ps(1.0f), packet.dx),
+            _mm_div_ps(_mm_set1_ps(1.0f), packet.dy),
+            _mm_div_ps(_mm_set1_ps(1.0f), packet.dz)
+        };
+        int stack[STACK_SIZE];
+        int stack_size = 0;
+        int node_index = 0;
+        __m128 tnear;
+        if (_mm_movemask_ps(nodes[0].box.intersect4(packet, inv_dir, hit_t, tnear)) == 0) {
+            return;
+        }
+        for (;;) {
+            const BVHNode& node = nodes[node_index];
+            STAT_ADD(STAT_BVH_NODES, 1);
+            if (node.count > 0) {
+                intersectLeaf(node.first, node.count);
+            }
+            else {
+                int near_child = node.first;
+                int far_child = node.first + 1;
+                __m128 t_near_child, t_far_child;
+                __m128 mask_near = nodes[near_child].box.intersect4(packet, inv_dir, hit_t, t_near_child);
+                __m128 mask_far = nodes[far_child].box.intersect4(packet, inv_dir, hit_t, t_far_child);
+                bool hit_near = _mm_movemask_ps(mask_near) != 0;
+                bool hit_far = _mm_movemask_ps(mask_far) != 0;
+                if (hit_near && hit_far) {
+                    if (minLane(mask_far, t_far_child) < minLane(mask_near, t_near_child)) {
+                        std::swap(near_child, far_child);
+                    }
+                    stack[stack_size++] = far_child;
+                    node_index = near_child;
+                    continue;
+                }
+                if (hit_near || hit_far) {
+                    node_index = hit_near ? near_child : far_child;
+                    continue;
+                }
+            }
+            if (stack_size == 0) {
+                return;
+            }
+            node_index = stack[--stack_size];
         }
     }
-};
 
-// -------------------------------------------------
+private:
+    static const int NUM_BINS = 16;
 
-void render(Scene& scene) {
-    OutputImage.clear(); // OutputImage ʱȭ
-    for (int j = 0; j < Height; ++j) {
-        for (int i = 0; i < Width; ++i) {
-            Ray ray = scene.camera.getRay(i, j); // ī޶ ȼ ǥ  
-            vec3 color = scene.trace(ray);       //  
+    static float minLane(__m128 mask, __m128 t) {
+        float lanes[4];
+        _mm_storeu_ps(lanes, select4(mask, t, _mm_set1_ps(INFINITY)));
+        return std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+    }
+
+    // ȸ  ܰ踶  ڽ ƾ ϳ Ƿ,  ̸ STACK_SIZE Ϸ θ  ġ ʽϴ.
+    //  ִ   Ʈ ׺  ϸ        ϴ.
+    static const int STACK_SIZE = 64;
 
-            //   
-            float gamma = 2.2f;
-            color.r = pow(color.r, 1.0f / gamma);
-            color.g = pow(color.g, 1.0f / gamma);
-            color.b = pow(color.b, 1.0f / gamma);
+    int max_leaf_size;
 
-            OutputImage.push_back(color);       // OutputImage  ߰
+    void subdivide(int node_index, const std::vector<AABB>& prim_bounds, int depth) {
+        BVHNode& node = nodes[node_index];
+        AABB centroid_bounds;
+        node.box = AABB();
+        for (int k = node.first; k < node.first + node.count; ++k) {
+            node.box.expand(prim_bounds[prim_ids[k]]);
+            centroid_bounds.expand(prim_bounds[prim_ids[k]].centroid());
+        }
+        if (node.count <= 1 || depth >= STACK_SIZE) {
+            return;
         }
-    }
-}
 
-void resize_callback(GLFWwindow*, int nw, int nh) {
-    Width = nw;
-    Height = nh;
-    glViewport(0, 0, nw, nh);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0.0, static_cast<double>(Width),
-        0.0, static_cast<double>(Height),
-        1.0, -1.0);
-    OutputImage.resize(Width * Height);
-}
+        // ߽    ࿡ binned SAH  ġ ϴ.
+        vec3 extent = centroid_bounds.hi - centroid_bounds.lo;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        if (extent[axis] <= 0.0f) {
+            return; //  ߽  ġ   
+        }
+        AABB bin_bounds[NUM_BINS];
+        int bin_counts[NUM_BINS] = { 0 };
+        float bin_scale = NUM_BINS / extent[axis];
+        for (int k = node.first; k < node.first + node.count; ++k) {
+            const AABB& box = prim_bounds[prim_ids[k]];
+            int bin = std::min(NUM_BINS - 1, static_cast<int>((box.centroid()[axis] - centroid_bounds.lo[axis]) * bin_scale));
+            bin_counts[bin]++;
+            bin_bounds[bin].expand(box);
+        }
+        float right_area[NUM_BINS];
+        int right_count[NUM_BINS];
+        AABB accum;
+        int count = 0;
+        for (int b = NUM_BINS - 1; b > 0; --b) {
+            accum.expand(bin_bounds[b]);
+            count += bin_counts[b];
+            right_area[b] = accum.area();
+            right_count[b] = count;
+        }
+        float best_cost = INFINITY;
+        int best_split = -1;
+        accum = AABB();
+        count = 0;
+        for (int b = 1; b < NUM_BINS; ++b) {
+            accum.expand(bin_bounds[b - 1]);
+            count += bin_counts[b - 1];
+            if (count == 0 || right_count[b] == 0) {
+                continue;
+            }
+            float cost = accum.area() * count + right_area[b] * right_count[b];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_split = b;
+            }
+        }
+        //    δ 뺸 ũ  ϴ (  = ȸ  ).
+        float leaf_cost = node.box.area() * node.count;
+        if (best_split < 0 || (node.count <= max_leaf_size && best_cost >= leaf_cost)) {
+            return;
+        }
+
+        int* begin = &prim_ids[0] + node.first;
+        int* end = begin + node.count;
+        int* mid = std::partition(begin, end, [&](int id) {
+            int bin = std::min(NUM_BINS - 1, static_cast<int>((prim_bounds[id].centroid()[axis] - centroid_bounds.lo[axis]) * bin_scale));
+            return bin < best_split;
+        });
+        int left_count = static_cast<int>(mid - begin);
+
+        int left_index = static_cast<int>(nodes.size());
+        BVHNode left, right;
+        left.first = node.first;
+        left.count = left_count;
+        right.first = node.first + left_count;
+        right.count = node.count - left_count;
+        nodes.push_back(left);
+        nodes.push_back(right);
+        nodes[node_index].first = left_index; // push_back Ŀ node  ȿ  
+        nodes[node_index].count = 0;
+        subdivide(left_index, prim_bounds, depth + 1);
+        subdivide(left_index + 1, prim_bounds, depth + 1);
+    }
+};
+
+// SphereSet Ŭ:  SoA 迭(߽, ,  ȣ)   ⺻  .
+//  Լ ȣ   , BVH  Ű 迭    ݺ ˻մϴ.
+class SphereSet {
+public:
+    Array<float> cx, cy, cz, radius; //  ˻ (߰ſ )
+    Array<int> material_id;          //  ó   ( )
+    BVH bvh; //  [first, first + count)  迭  ״ Ŵ
+    bool dirty = false; //  ߰Ǿ BVH ٽ   (   false)
+    bool moved = false; //  Ű BVH  ڸ ٽ ϸ 
+
+    int size() const {
+        return static_cast<int>(radius.size());
+    }
+
+    void add(const vec3& center, float r, int m) {
+        cx.push_back(center.x);
+        cy.push_back(center.y);
+        cz.push_back(center.z);
+        radius.push_back(r);
+        material_id.push_back(m);
+        dirty = true;
+    }
+
+    vec3 center(int k) const {
+        return vec3(cx[k], cy[k], cz[k]);
+    }
+
+    AABB bounds(int k) const {
+        return AABB(center(k) - vec3(radius[k]), center(k) + vec3(radius[k]));
+    }
+
+    //  k űų ũ⸦ ٲߴϴ. 迭  ״̹Ƿ  build() BVH ٽ  ʰ ڸ ϴ.
+    void move(int k, const vec3& new_center, float r) {
+        cx[k] = new_center.x;
+        cy[k] = new_center.y;
+        cz[k] = new_center.z;
+        radius[k] = r;
+        moved = true;
+    }
+
+    //  k ϴ.   k Űϴ.
+    void remove(int k) {
+        int last = size() - 1;
+        cx[k] = cx[last];
+        cy[k] = cy[last];
+        cz[k] = cz[last];
+        radius[k] = radius[last];
+        material_id[k] = material_id[last];
+        cx.resize(last);
+        cy.resize(last);
+        cz.resize(last);
+        radius.resize(last);
+        material_id.resize(last);
+        dirty = true;
+    }
+
+    bool needsBuild() const {
+        return dirty || moved;
+    }
+
+    // BVH     迭 ġ, ȸ ߿ prim_ids ġ ʰ ٷ εմϴ.
+    void build() {
+        if (!needsBuild()) {
+            return;
+        }
+        std::vector<AABB> prim_bounds(size());
+        for (int k = 0; k < size(); ++k) {
+            prim_bounds[k] = bounds(k);
+        }
+        moved = false;
+        if (!dirty) {
+            bvh.refit(prim_bounds); // 迭 ̹  
+            return;
+        }
+        bvh.build(prim_bounds, LEAF_SIZE);
+        permute(cx);
+        permute(cy);
+        permute(cz);
+        permute(radius);
+        permute(material_id);
+        for (int k = 0; k < size(); ++k) {
+            bvh.prim_ids[k] = k;
+        }
+        dirty = false;
+    }
+
+    //           ã ray.tmax ̰  ȣ ȯմϴ ( -1).
+    // ݺ б   ̶ Ϸ      ϵ ȭ  ֽϴ.
+    int intersectRange(int first, int count, Ray& ray) const {
+        int closest = -1;
+        float t[LEAF_SIZE];
+        for (int base = first; base < first + count; base += LEAF_SIZE) {
+            int n = std::min(LEAF_SIZE, first + count - base);
+            intersectBlock(base, n, ray, t);
+            for (int k = 0; k < n; ++k) {
+                if (t[k] < ray.tmax) {
+                    ray.tmax = t[k];
+                    closest = base + k;
+                }
+            }
+        }
+        return closest;
+    }
+
+    //       ȿ    ִ Ȯմϴ.
+    bool occludedRange(int first, int count, const Ray& ray) const {
+        float t[LEAF_SIZE];
+        for (int base = first; base < first + count; base += LEAF_SIZE) {
+            int n = std::min(LEAF_SIZE, first + count - base);
+            intersectBlock(base, n, ray, t);
+            bool hit = false;
+            for (int k = 0; k < n; ++k) {
+                hit |= t[k] < ray.tmax;
+            }
+            if (hit) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //     4 ˻ κ    hit ݿմϴ.
+    void intersectRange4(int first, int count, const RayPacket4& packet, PacketHit& hit) const {
+        STAT_ADD(STAT_SPHERE_TESTS, 4 * count);
+        for (int k = first; k < first + count; ++k) {
+            __m128 t = hit.t;
+            __m128 mask = intersectSphere4(packet, cx[k], cy[k], cz[k], radius[k], t);
+            mask = _mm_and_ps(mask, _mm_cmplt_ps(t, hit.t));
+            int lanes = _mm_movemask_ps(mask);
+            if (lanes == 0) {
+                continue;
+            }
+            hit.t = select4(mask, t, hit.t);
+            for (int lane = 0; lane < 4; ++lane) {
+                if (lanes & (1 << lane)) {
+                    hit.surface[lane] = nullptr;
+                    hit.sphere[lane] = k;
+                    hit.instance[lane] = nullptr;
+                }
+            }
+        }
+    }
+
+private:
+    static const int LEAF_SIZE = 8; // AVX 8     ũ
+
+    template <class T>
+    void permute(Array<T>& values) const {
+        std::vector<T> sorted;
+        sorted.reserve(values.size());
+        for (int id : bvh.prim_ids) {
+            sorted.push_back(values[id]);
+        }
+        values.swap(sorted);
+    }
+
+    //  n(n <= LEAF_SIZE) t > ray.tmin    t[] ϴ ( INFINITY).
+    void intersectBlock(int first, int n, const Ray& ray, float* t) const {
+        STAT_ADD(STAT_SPHERE_TESTS, n);
+        const float* px = &cx[first];
+        const float* py = &cy[first];
+        const float* pz = &cz[first];
+        const float* pr = &radius[first];
+        const vec3 o = ray.origin;
+        const vec3 d = ray.direction;
+        const float tmin = ray.tmin;
+        const float a = dot(d, d);
+        for (int k = 0; k < n; ++k) {
+            float ocx = o.x - px[k];
+            float ocy = o.y - py[k];
+            float ocz = o.z - pz[k];
+            float b = ocx * d.x + ocy * d.y + ocz * d.z; //  b 
+            float c = ocx * ocx + ocy * ocy + ocz * ocz - pr[k] * pr[k];
+            float discriminant = b * b - a * c;
+            float root = std::sqrt(std::max(discriminant, 0.0f));
+            float t0 = (-b - root) / a;
+            float t1 = (-b + root) / a;
+            float nearest = t0 > tmin ? t0 : t1;
+            t[k] = (discriminant >= 0.0f && nearest > tmin) ? nearest : INFINITY;
+        }
+    }
+};
+
+const int SphereSet::LEAF_SIZE; // std::min  Ƿ ǰ ʿ (C++14)
+
+// TriangleRay ü: ŸƮ -ﰢ (Woop et al. 2013)   .
+//   +z ǵ  ٲٰ  ȯ 2D  𼭸 Լ ϹǷ, ̿ ﰢ
+// ϴ 𼭸 ʿ Ȱ    𼭸 ̷  ʽϴ.
+struct TriangleRay {
+    vec3 origin;
+    int kx, ky, kz;   //   (kz:     ū )
+    float sx, sy, sz; //  
+
+    explicit TriangleRay(const Ray& ray) : origin(ray.origin) {
+        vec3 d = ray.direction;
+        vec3 ad = abs(d);
+        kz = ad.x > ad.y ? (ad.x > ad.z ? 0 : 2) : (ad.y > ad.z ? 1 : 2);
+        kx = kz == 2 ? 0 : kz + 1;
+        ky = kx == 2 ? 0 : kx + 1;
+        if (d[kz] < 0.0f) {
+            std::swap(kx, ky); // ﰢ   
+        }
+        sx = d[kx] / d[kz];
+        sy = d[ky] / d[kz];
+        sz = 1.0f / d[kz];
+    }
+};
+
+// TriangleMesh Ŭ:  ġ  迭 ϴ ε ﰢ ޽.
+// ﰢ Surface ü  ʰ ޽ ϳ ﰢ  BVH ,  BVH ǥ ϳ ϴ.
+// 迭 ä  build() ȣؾ մϴ.
+class TriangleMesh : public Surface {
+public:
+    std::vector<vec3> positions;
+    std::vector<vec3> normals;       //     
+    std::vector<int> position_index; // ﰢ 3
+    std::vector<int> normal_index;   // ﰢ 3 (normals    )
+    int material_id;
+    BVH bvh; //  [first, first + count) ﰢ ȣ  ״ Ŵ
+
+    explicit TriangleMesh(int material_id) : material_id(material_id) {}
+
+    int size() const {
+        return static_cast<int>(position_index.size() / 3);
+    }
+
+    // ﰢ  BVH  SphereSetó ε 迭   ġմϴ.
+    void build() {
+        std::vector<AABB> bounds(size());
+        for (int k = 0; k < size(); ++k) {
+            for (int corner = 0; corner < 3; ++corner) {
+                bounds[k].expand(positions[position_index[3 * k + corner]]);
+            }
+        }
+        bvh.build(bounds, 4);
+        permute(position_index);
+        if (!normal_index.empty()) {
+            permute(normal_index);
+        }
+        for (int k = 0; k < size(); ++k) {
+            bvh.prim_ids[k] = k;
+        }
+    }
+
+    bool intersect(const Ray& ray, float& t) const override {
+        Ray closest_ray = ray;
+        Hit hit;
+        if (!intersectClosest(closest_ray, hit)) {
+            return false;
+        }
+        t = hit.t;
+        return true;
+    }
+
+    bool intersectClosest(Ray& ray, Hit& hit) const override {
+        TriangleRay triangle_ray(ray);
+        int closest = -1;
+        bvh.traverse(ray, [&](int first, int count) {
+            for (int k = first; k < first + count; ++k) {
+                float t;
+                if (intersectTriangle(k, triangle_ray, ray.tmin, ray.tmax, t)) {
+                    ray.tmax = t;
+                    closest = k;
+                }
+            }
+            return false;
+        });
+        if (closest < 0) {
+            return false;
+        }
+        hit.t = ray.tmax;
+        hit.surface = this;
+        hit.sphere = -1;
+        hit.prim = closest;
+        hit.instance = nullptr;
+        return true;
+    }
+
+    bool occluded(const Ray& ray) const override {
+        TriangleRay triangle_ray(ray);
+        bool hit = false;
+        bvh.traverse(ray, [&](int first, int count) {
+            float t;
+            for (int k = first; k < first + count && !hit; ++k) {
+                hit = intersectTriangle(k, triangle_ray, ray.tmin, ray.tmax, t);
+            }
+            return hit;
+        });
+        return hit;
+    }
+
+    //   BVH ȸϰ,  ﰢ θ ŸƮ Ŀη ˻մϴ.
+    void intersect4(const RayPacket4& packet, PacketHit& hit) const override {
+        const TriangleRay rays[4] = { TriangleRay(packet.ray(0)), TriangleRay(packet.ray(1)), TriangleRay(packet.ray(2)), TriangleRay(packet.ray(3)) };
+        bvh.traversePacket(packet, hit.t, [&](int first, int count) {
+            float closest[4];
+            _mm_storeu_ps(closest, hit.t);
+            for (int lane = 0; lane < 4; ++lane) {
+                for (int k = first; k < first + count; ++k) {
+                    float t;
+                    if (intersectTriangle(k, rays[lane], 0.0f, closest[lane], t)) {
+                        closest[lane] = t;
+                        hit.surface[lane] = this;
+                        hit.sphere[lane] = -1;
+                        hit.prim[lane] = k;
+                        hit.instance[lane] = nullptr;
+                    }
+                }
+            }
+            hit.t = _mm_loadu_ps(closest);
+        });
+    }
+
+    //     ߽ ǥ ϰ,    մϴ.
+    vec3 getNormal(const vec3& point, int prim) const override {
+        const int* p = &position_index[3 * prim];
+        vec3 e1 = positions[p[1]] - positions[p[0]];
+        vec3 e2 = positions[p[2]] - positions[p[0]];
+        vec3 face_normal = cross(e1, e2);
+        if (normals.empty()) {
+            return normalize(face_normal);
+        }
+        vec3 rel = point - positions[p[0]];
+        float inv_area = 1.0f / dot(face_normal, face_normal);
+        float b1 = dot(cross(rel, e2), face_normal) * inv_area;
+        float b2 = dot(cross(e1, rel), face_normal) * inv_area;
+        const int* n = &normal_index[3 * prim];
+        return normalize(normals[n[0]] * (1.0f - b1 - b2) + normals[n[1]] * b1 + normals[n[2]] * b2);
+    }
+
+    int getMaterialId() const override {
+        return material_id;
+    }
+
+    bool getBounds(AABB& box) const override {
+        if (bvh.nodes.empty()) {
+            return false;
+        }
+        box = bvh.nodes[0].box;
+        return true;
+    }
+
+private:
+    void permute(std::vector<int>& index) const {
+        std::vector<int> sorted;
+        sorted.reserve(index.size());
+        for (int id : bvh.prim_ids) {
+            sorted.insert(sorted.end(), &index[3 * id], &index[3 * id] + 3);
+        }
+        index.swap(sorted);
+    }
+
+    // ﰢ k (tmin, tmax) ȿ ϴ ˻մϴ.  ̸, б   Ӵϴ.
+    bool intersectTriangle(int k, const TriangleRay& ray, float tmin, float tmax, float& t) const {
+        STAT_ADD(STAT_TRIANGLE_TESTS, 1);
+        const int* p = &position_index[3 * k];
+        vec3 a = positions[p[0]] - ray.origin;
+        vec3 b = positions[p[1]] - ray.origin;
+        vec3 c = positions[p[2]] - ray.origin;
+        float ax = a[ray.kx] - ray.sx * a[ray.kz];
+        float ay = a[ray.ky] - ray.sy * a[ray.kz];
+        float bx = b[ray.kx] - ray.sx * b[ray.kz];
+        float by = b[ray.ky] - ray.sy * b[ray.kz];
+        float cx = c[ray.kx] - ray.sx * c[ray.kz];
+        float cy = c[ray.ky] - ray.sy * c[ray.kz];
+        float u = cx * by - cy * bx;
+        float v = ax * cy - ay * cx;
+        float w = bx * ay - by * ax;
+        if (u == 0.0f || v == 0.0f || w == 0.0f) {
+            //  𼭸 Ȯ  float ݿø   Ƿ double ٽ 
+            u = static_cast<float>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+            v = static_cast<float>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+            w = static_cast<float>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+        }
+        float det = u + v + w;
+        float scaled_t = (u * a[ray.kz] + v * b[ray.kz] + w * c[ray.kz]) * ray.sz;
+        // det ȣ    t  
+        float sign = det < 0.0f ? -1.0f : 1.0f;
+        det *= sign;
+        scaled_t *= sign;
+        bool inside = std::min(u, std::min(v, w)) >= 0.0f || std::max(u, std::max(v, w)) <= 0.0f;
+        if (!inside || det == 0.0f || scaled_t <= tmin * det || scaled_t >= tmax * det) {
+            return false;
+        }
+        t = scaled_t / det;
+        return true;
+    }
+};
+
+// Scene Ŭ:  մϴ.
+class Scene {
+public:
+    std::vector<Surface*> objects;
+    SphereSet spheres; //   Լ  SoA ҿ  ˻
+    std::vector<Material> materials; //  ̺: ǥ   ʰ ȣ Ŵ
+    Camera camera;
+    std::vector<Light> lights; //   (ڰ Ÿ    ϳ )
+
+    Scene(const Camera& camera, const vec3& light_pos)
+        : camera(camera), material_owner(nullptr), accel_dirty(true), geometry_version(0), material_version(0), edited_all(true) {
+        lights.push_back(Light(light_pos));
+    }
+
+    void addObject(Surface* object) {
+        objects.push_back(object);
+        accel_dirty = true;
+        ++geometry_version;
+        recordEdit(object, true);
+    }
+
+    void addSphere(const vec3& center, float radius, int material_id) {
+        spheres.add(center, radius, material_id);
+        accel_dirty = true;
+        ++geometry_version;
+        recordEdit(spheres.bounds(spheres.size() - 1), true);
+    }
+
+    //  ٲߴϴ. ϰ ״̹Ƿ G-buffer  ٽ   ֽϴ.
+    void setMaterial(int id, const Material& material) {
+        if (material_owner) {
+            material_owner->setMaterial(id, material);
+            return;
+        }
+        materials[id] = material;
+        materials[id].model = material.selectModel();
+        ++material_version;
+    }
+
+    //  : Ʒ Լ  ٲٸ鼭  Ŀ  ޴    ϰ,
+    // renderDirty()   ̰ų ׸ڸ 帮 Ÿϸ ٽ մϴ.
+    //  ȣ k Hit::sphere   (  籸) ȿմϴ.
+
+    //  k űų ũ⸦ ٲߴϴ.  BVH ٽ  ʰ  ڸ ϴ.
+    void moveSphere(int k, const vec3& center, float radius) {
+        recordEdit(spheres.bounds(k), true);
+        spheres.move(k, center, radius);
+        recordEdit(spheres.bounds(k), true);
+        ++geometry_version;
+    }
+
+    //  k ϴ.   k Űϴ.
+    void removeSphere(int k) {
+        recordEdit(spheres.bounds(k), true);
+        spheres.remove(k);
+        ++geometry_version;
+    }
+
+    void setSphereMaterial(int k, int material_id) {
+        recordEdit(spheres.bounds(k), false);
+        spheres.material_id[k] = material_id;
+        ++geometry_version; // G-buffer  ȣ ϹǷ
+    }
+
+    // ǥ 鿡 ϴ (ǥ ü ȣ  ). ǥ ű   ǥ մϴ.
+    bool removeObject(Surface* object) {
+        auto found = std::find(objects.begin(), objects.end(), object);
+        if (found == objects.end()) {
+            return false;
+        }
+        recordEdit(object, true);
+        objects.erase(found);
+        accel_dirty = true;
+        ++geometry_version;
+        return true;
+    }
+
+    //     . editedAll() true  𸣹Ƿ ü ٽ ؾ մϴ.
+    const std::vector<EditRegion>& editRegions() const {
+        return edit_regions;
+    }
+
+    bool editedAll() const {
+        return edited_all;
+    }
+
+    //    ݿ  θϴ.
+    void clearEdits() {
+        edit_regions.clear();
+        edited_all = false;
+    }
+
+    //  ߰ǰų ٲ  ϴ ȣ (G-buffer  ȿ Ȯ  )
+    unsigned geometryVersion() const {
+        return geometry_version;
+    }
+
+    // setMaterial()  ٲ  ϴ ȣ
+    unsigned materialVersion() const {
+        return material_version;
+    }
+
+    // Instance ų   ϴ.    ϸ   Բ ˴ϴ.
+    // νϽ     ̺ ϹǷ,  addMaterial() setMaterial()   ̺ ϴ.
+    Scene& addPrototype() {
+        prototypes.push_back(std::unique_ptr<Scene>(new Scene(camera, vec3(0.0f)))); //  ī޶   
+        prototypes.back()->material_owner = this;
+        return *prototypes.back();
+    }
+
+    bool isPrototype() const {
+        return material_owner != nullptr;
+    }
+
+    //  ̺ ϰ ǥ  ȣ ȯմϴ.
+    int addMaterial(const Material& material) {
+        if (material_owner) {
+            return material_owner->addMaterial(material);
+        }
+        materials.push_back(material);
+        materials.back().model = material.selectModel();
+        return static_cast<int>(materials.size()) - 1;
+    }
+
+    //    Լ:  ҿ 谡 ִ ǥ  BVH,  ǥ   Ӵϴ.
+    // ü ߰  ó   render() ȣ˴ϴ.
+    void buildAccel() {
+        if (!accel_dirty && !spheres.needsBuild()) {
+            return;
+        }
+        STAT_SCOPE("buildAccel");
+        spheres.build();
+        if (!accel_dirty) {
+            return; //  ٲ
+        }
+        bounded.clear();
+        unbounded.clear();
+        std::vector<AABB> bounds;
+        for (Surface* object : objects) {
+            AABB box;
+            if (object->getBounds(box)) {
+                bounded.push_back(object);
+                bounds.push_back(box);
+            }
+            else {
+                unbounded.push_back(object);
+            }
+        }
+        bvh.build(bounds);
+        accel_dirty = false;
+    }
+
+    //   ȿ    ã Լ. ã ray.tmax  Ÿ پϴ.
+    bool intersect(Ray& ray, Hit& hit) const {
+        hit = Hit();
+        for (const Surface* object : unbounded) {
+            object->intersectClosest(ray, hit);
+        }
+        spheres.bvh.traverse(ray, [&](int first, int count) {
+            int sphere = spheres.intersectRange(first, count, ray);
+            if (sphere >= 0) {
+                hit.t = ray.tmax;
+                hit.surface = nullptr;
+                hit.sphere = sphere;
+                hit.instance = nullptr;
+            }
+            return false;
+        });
+        bvh.traverse(ray, [&](int first, int count) {
+            for (int k = first; k < first + count; ++k) {
+                bounded[bvh.prim_ids[k]]->intersectClosest(ray, hit);
+            }
+            return false;
+        });
+        return hit.valid();
+    }
+
+    // ׸    Լ:    ü ϳ ã ٷ true ȯմϴ.
+    bool occluded(const Ray& ray) const {
+        for (const Surface* object : unbounded) {
+            if (object->occluded(ray)) {
+                return true;
+            }
+        }
+        bool hit = false;
+        spheres.bvh.traverse(ray, [&](int first, int count) {
+            hit = spheres.occludedRange(first, count, ray);
+            return hit;
+        });
+        if (hit) {
+            return true;
+        }
+        bvh.traverse(ray, [&](int first, int count) {
+            for (int k = first; k < first + count && !hit; ++k) {
+                hit = bounded[bvh.prim_ids[k]]->occluded(ray);
+            }
+            return hit;
+        });
+        return hit;
+    }
+
+    //   κ    ã Լ
+    void intersect4(const RayPacket4& packet, PacketHit& hit) const {
+        hit = PacketHit();
+        for (const Surface* object : unbounded) {
+            object->intersect4(packet, hit);
+        }
+        spheres.bvh.traversePacket(packet, hit.t, [&](int first, int count) {
+            spheres.intersectRange4(first, count, packet, hit);
+        });
+        bvh.traversePacket(packet, hit.t, [&](int first, int count) {
+            for (int k = first; k < first + count; ++k) {
+                bounded[bvh.prim_ids[k]]->intersect4(packet, hit);
+            }
+        });
+    }
+
+    //    óϴ Լ
+    vec3 shade(const Ray& ray, const Hit& hit, const LightList& light_list) const {
+        ShadingPoint point;
+        //     ü ִ°
+        if (!surfacePoint(ray, hit, point)) {
+            return vec3(0.0f, 0.0f, 0.0f); //  ȯ ()
+        }
+        return shadePoint(point, light_list);
+    }
+
+    //    ó ʿ  մϴ.  ʾ false.
+    bool surfacePoint(const Ray& ray, const Hit& hit, ShadingPoint& point) const {
+        if (!hit.valid()) {
+            return false;
+        }
+        point.position = ray.origin + ray.direction * hit.t; //  
+        point.depth = hit.t;
+        getSurface(ray, hit, point.normal, point.material_id); //   Ϳ  ȣ
+        return true;
+    }
+
+    //   óϴ Լ
+    vec3 shadePoint(const ShadingPoint& point, const LightList& light_list) const {
+        STAT_ADD(STAT_SHADED_HITS, 1);
+        const Material& material = materials[point.material_id];                         //  ǥ   (  )
+        return phongShading(point.position, point.normal, material, light_list);         // Phong  ó 
+    }
+
+    //     ȣ մϴ. νϽ    鿡    űϴ.
+    void getSurface(const Ray& ray, const Hit& hit, vec3& normal, int& material_id) const;
+
+    //  ü  ڸ մϴ (νϽ , buildAccel ).  ǥ  false.
+    bool getBounds(AABB& box) const {
+        if (!unbounded.empty()) {
+            return false;
+        }
+        box = AABB();
+        if (!spheres.bvh.nodes.empty()) {
+            box.expand(spheres.bvh.nodes[0].box);
+        }
+        if (!bvh.nodes.empty()) {
+            box.expand(bvh.nodes[0].box);
+        }
+        return true;
+    }
+
+    // Phong  ó  Լ:   𵨿 ° Ưȭ Լ бմϴ.
+    vec3 phongShading(const vec3& point, const vec3& normal, const Material& material, const LightList& light_list) const {
+        switch (material.model) {
+        case ShadingModel::Ambient:
+            return material.ka; //  
+        case ShadingModel::Lambert:
+            return phongShading<ShadingModel::Lambert>(point, normal, material, light_list);
+        default:
+            return phongShading<ShadingModel::BlinnPhong>(point, normal, material, light_list);
+        }
+    }
+
+    // ambient   ϰ, Ȯ( ݻ)    ׸ڸ Ȯ մϴ.
+    template <ShadingModel Model>
+    vec3 phongShading(const vec3& point, const vec3& normal, const Material& material, const LightList& light_list) const {
+        // Ambient  
+        vec3 color = material.ka;
+
+        for (int k = 0; k < light_list.count; ++k) {
+            const Light& light = lights[light_list.ids[k]];
+            vec3 light_dir, diffuse, specular;
+            float light_distance;
+            Ray shadow_ray;
+            if (!light.reaches(point, light_dir, light_distance)
+                || !lightSample<Model>(light, point, normal, light_dir, light_distance, material, diffuse, specular, shadow_ray)) {
+                continue;
+            }
+            // ׸ : ׸      
+            STAT_ADD(STAT_SHADOW_RAYS, 1);
+            if (!occluded(shadow_ray)) {
+                color += diffuse;
+                if (Model == ShadingModel::BlinnPhong) {
+                    color += specular;
+                }
+            }
+        }
+        return color;
+    }
+
+    //   𵨷 lightSample θϴ. Lambert  specular 0Դϴ. Ambient  θ ʽϴ.
+    bool lightSample(const Light& light, const vec3& point, const vec3& normal, const vec3& light_dir, float light_distance,
+        const Material& material, vec3& diffuse, vec3& specular, Ray& shadow_ray) const {
+        if (material.model == ShadingModel::Lambert) {
+            specular = vec3(0.0f);
+            return lightSample<ShadingModel::Lambert>(light, point, normal, light_dir, light_distance, material,
+                diffuse, specular, shadow_ray);
+        }
+        return lightSample<ShadingModel::BlinnPhong>(light, point, normal, light_dir, light_distance, material,
+            diffuse, specular, shadow_ray);
+    }
+
+    //  ϳ  ϴ Ȯ, ݻ а     ִ ׸ ( ) մϴ.
+    // light_dir light_distance Light::reaches()  ˻縦 ϸ    ŸԴϴ.
+    // 谡 0̰ų  ǥ ʿ  (N.L <= 0)   Ƿ false ȯϰ ׸   ʽϴ.
+    // Lambert  specular ǵ帮 ʽϴ.
+    template <ShadingModel Model>
+    bool lightSample(const Light& light, const vec3& point, const vec3& normal, const vec3& light_dir, float light_distance,
+        const Material& material, vec3& diffuse, vec3& specular, Ray& shadow_ray) const {
+        float diff = dot(normal, light_dir); //  Ϳ    
+        if (diff <= 0.0f) {
+            return false;
+        }
+        float attenuation = light.attenuation(light_dir, light_distance);
+        if (attenuation <= 0.0f) {
+            return false;
+        }
+        vec3 intensity = light.color * attenuation;
+
+        // Diffuse  
+        diffuse = material.kd * diff * intensity;
+
+        // Specular  
+        if (Model == ShadingModel::BlinnPhong) {
+            vec3 view_dir = normalize(-point); //   ϴ   (ī޶  ִٰ )
+            vec3 half_vector = normalize(light_dir + view_dir); // Half-vector  (Blinn-Phong )
+            float spec = pow(max(dot(normal, half_vector), 0.0f), material.specular_power); //  Ϳ half-vector 
+            specular = material.ks * spec * intensity;
+        }
+
+        vec3 origin = point + normal * SHADOW_EPSILON; // Offset to avoid self-intersection
+        shadow_ray = Ray(origin, light_dir, SHADOW_EPSILON, length(light.position - origin)); //  ʸ ü ׸ڸ  
+        return true;
+    }
+
+private:
+    std::vector<Surface*> bounded;   // BVH  ǥ (prim_id )
+    std::vector<Surface*> unbounded; // ó 谡  Ź ˻ϴ ǥ
+    std::vector<std::unique_ptr<Scene>> prototypes; // addPrototype()   
+    Scene* material_owner; // ̸  ̺  , ƴϸ nullptr
+    BVH bvh;
+    bool accel_dirty;
+    unsigned geometry_version;
+    unsigned material_version;
+    std::vector<EditRegion> edit_regions;
+    bool edited_all; // ó  ̰ų  ǥ ٲ
+
+    void recordEdit(const AABB& box, bool shadows) {
+        if (!edited_all) { // ó     ̹Ƿ  
+            EditRegion region = { box, shadows };
+            edit_regions.push_back(region);
+        }
+    }
+
+    void recordEdit(const Surface* object, bool shadows) {
+        AABB box;
+        if (object->getBounds(box)) {
+            recordEdit(box, shadows);
+        }
+        else {
+            edited_all = true;
+        }
+    }
+};
+
+// Instance Ŭ: ϴ  (prototype) ȯ ķ ġ νϽ.
+//  Ϳ    ϳ ְ νϽ ĸ Ƿ, ޸𸮰 纻  x  ũⰡ
+// ƴ϶ 纻  +  ũ⿡ մϴ.   ü  Ű  BVH ״ ȸϸ,
+//  ȭ Ƿ t   ϴ.  ȿ ٽ νϽ   ϴ.
+//  ǥ  ȣ   ̺ Ѿ ϹǷ    addPrototype() ϴ.
+class Instance : public Surface {
+public:
+    const Scene* prototype;
+    mat4 transform;         // ü  ->  
+    mat4 inverse_transform; //   -> ü 
+    mat3 normal_matrix;     //  ȯ (transform ġ)
+
+    Instance(Scene& prototype, const mat4& transform)
+        : prototype(&prototype), transform(transform), inverse_transform(inverse(transform)),
+        normal_matrix(transpose(mat3(inverse_transform))) {
+        assert(prototype.isPrototype() && "Instance:  Scene::addPrototype()  ");
+        prototype.buildAccel();
+        AABB local;
+        bounded = prototype.getBounds(local);
+        if (bounded) {
+            for (int corner = 0; corner < 8; ++corner) {
+                vec3 p((corner & 1) ? local.hi.x : local.lo.x, (corner & 2) ? local.hi.y : local.lo.y, (corner & 4) ? local.hi.z : local.lo.z);
+                bounds.expand(vec3(transform * vec4(p, 1.0f)));
+            }
+        }
+    }
+
+    Ray toLocal(const Ray& ray) const {
+        return Ray(vec3(inverse_transform * vec4(ray.origin, 1.0f)), vec3(inverse_transform * vec4(ray.direction, 0.0f)), ray.tmin, ray.tmax);
+    }
+
+    bool intersect(const Ray& ray, float& t) const override {
+        Ray closest_ray = ray;
+        Hit hit;
+        if (!intersectClosest(closest_ray, hit)) {
+            return false;
+        }
+        t = hit.t;
+        return true;
+    }
+
+    bool intersectClosest(Ray& ray, Hit& hit) const override {
+        Ray local = toLocal(ray); //  ״ (t   )
+        Hit local_hit;
+        if (!prototype->intersect(local, local_hit)) {
+            return false;
+        }
+        ray.tmax = local.tmax;
+        hit = local_hit;
+        hit.instance = this;
+        return true;
+    }
+
+    bool occluded(const Ray& ray) const override {
+        return prototype->occluded(toLocal(ray));
+    }
+
+    void intersect4(const RayPacket4& packet, PacketHit& hit) const override {
+        const mat4& m = inverse_transform;
+        RayPacket4 local = packet;
+        local.ox = transform4(m, 0, packet.ox, packet.oy, packet.oz, _mm_set1_ps(m[3][0]));
+        local.oy = transform4(m, 1, packet.ox, packet.oy, packet.oz, _mm_set1_ps(m[3][1]));
+        local.oz = transform4(m, 2, packet.ox, packet.oy, packet.oz, _mm_set1_ps(m[3][2]));
+        local.dx = transform4(m, 0, packet.dx, packet.dy, packet.dz, _mm_setzero_ps());
+        local.dy = transform4(m, 1, packet.dx, packet.dy, packet.dz, _mm_setzero_ps());
+        local.dz = transform4(m, 2, packet.dx, packet.dy, packet.dz, _mm_setzero_ps());
+        PacketHit local_hit;
+        local_hit.t = hit.t; // t   Ƿ ̹ ã     ȿ ǳʶ
+        prototype->intersect4(local, local_hit);
+        __m128 closer = _mm_cmplt_ps(local_hit.t, hit.t);
+        int lanes = _mm_movemask_ps(closer);
+        if (lanes == 0) {
+            return;
+        }
+        hit.t = select4(closer, local_hit.t, hit.t);
+        for (int lane = 0; lane < 4; ++lane) {
+            if (lanes & (1 << lane)) {
+                hit.surface[lane] = local_hit.surface[lane];
+                hit.sphere[lane] = local_hit.sphere[lane];
+                hit.prim[lane] = local_hit.prim[lane];
+                hit.instance[lane] = this;
+            }
+        }
+    }
+
+    // νϽ  Hit::instance   鿡   ϹǷ Ʒ  Լ Ҹ  ˴ϴ.
+    vec3 getNormal(const vec3& point, int prim) const override {
+        assert(!"Instance::getNormal: Hit::instance   ǥ ãƾ ");
+        return vec3(0, 1, 0);
+    }
+
+    int getMaterialId() const override {
+        assert(!"Instance::getMaterialId: Hit::instance   ǥ ãƾ ");
+        return 0;
+    }
+
+    bool getBounds(AABB& box) const override {
+        box = bounds;
+        return bounded;
+    }
+
+private:
+    AABB bounds;  //    
+    bool bounded; //  ó  ǥ  false
+
+    //  row°   4  մϴ (glm   켱).
+    static __m128 transform4(const mat4& m, int row, __m128 x, __m128 y, __m128 z, __m128 w) {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][row]), x), _mm_mul_ps(_mm_set1_ps(m[1][row]), y)),
+            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2][row]), z), w));
+    }
+};
+
+void Scene::getSurface(const Ray& ray, const Hit& hit, vec3& normal, int& material_id) const {
+    if (hit.instance) {
+        Hit local_hit = hit;
+        local_hit.instance = nullptr;
+        hit.instance->prototype->getSurface(hit.instance->toLocal(ray), local_hit, normal, material_id);
+        normal = normalize(hit.instance->normal_matrix * normal);
+        return;
+    }
+    vec3 point = ray.origin + ray.direction * hit.t;
+    if (hit.sphere >= 0) {
+        normal = normalize(point - spheres.center(hit.sphere));
+        material_id = spheres.material_id[hit.sphere];
+        return;
+    }
+    normal = hit.surface->getNormal(point, hit.prim);
+    if (hit.prim >= 0 && dot(normal, ray.direction) > 0.0f) {
+        normal = -normal; // ﰢ ̹Ƿ   ϰ 
+    }
+    material_id = hit.surface->getMaterialId();
+}
+
+// -------------------------------------------------
+
+// -------------------------------------------------
+// Tile ü:  ۾  ȭ 簢  [x0, x1) x [y0, y1)
+struct Tile {
+    int x0, y0, x1, y1;
+};
+
+// 16x16 ȼ Ÿ (3KB) L1 ĳÿ , 512x512 ̹ 1024 Ÿ   л꿡 մϴ.
+const int TILE_SIZE = 16;
+int NumThreads = 0; //    (0̸ ϵ ھ )
+bool UsePacketTracing = true; // 1  2x2 ȼ   
+bool UseWavefront = false;    // ܰ躰  ť   (renderWavefront)
+
+int renderThreadCount() {
+    if (NumThreads > 0) {
+        return NumThreads;
+    }
+    unsigned int cores = std::thread::hardware_concurrency();
+    return cores > 0 ? static_cast<int>(cores) : 1;
+}
+
+// TileScheduler Ŭ: ̹ ŸϷ  庰 ť йϰ,
+// ڱ ť   ٸ  ť Ÿ Ŀɴϴ (work stealing).
+//   Ÿ  ϴ ŸϺ ξ ιǷ  й踸δ ھ  ˴ϴ.
+class TileScheduler {
+public:
+    TileScheduler(int width, int height, int tile_size, int num_workers)
+        : queues(std::max(num_workers, 1)) {
+        int tiles_x = (width + tile_size - 1) / tile_size;
+        int tiles_y = (height + tile_size - 1) / tile_size;
+        int num_tiles = tiles_x * tiles_y;
+        int num_queues = static_cast<int>(queues.size());
+        //  Ÿ   忡   ó  մϴ.
+        for (int k = 0; k < num_tiles; ++k) {
+            Tile tile;
+            tile.x0 = (k % tiles_x) * tile_size;
+            tile.y0 = (k / tiles_x) * tile_size;
+            tile.x1 = std::min(tile.x0 + tile_size, width);
+            tile.y1 = std::min(tile.y0 + tile_size, height);
+            queues[static_cast<size_t>(k) * num_queues / num_tiles].tiles.push_back(tile);
+        }
+    }
+
+    // ־ Ÿ ϸ  óմϴ (Ϻ Ÿϸ ٽ  ).
+    TileScheduler(const std::vector<Tile>& tiles, int num_workers)
+        : queues(std::max(num_workers, 1)) {
+        size_t num_queues = queues.size();
+        for (size_t k = 0; k < tiles.size(); ++k) {
+            queues[k * num_queues / tiles.size()].tiles.push_back(tiles[k]);
+        }
+    }
+
+    // Ÿ  ȣ 0..count-1  (  + Ŀ)  work(index) մϴ.
+    template <class Work>
+    static void runRange(int count, int num_workers, const Work& work) {
+        std::vector<Tile> items(static_cast<size_t>(std::max(count, 0)));
+        for (int k = 0; k < count; ++k) {
+            Tile item = { k, 0, k + 1, 1 };
+            items[k] = item;
+        }
+        TileScheduler scheduler(items, num_workers);
+        scheduler.run([&work](const Tile& item) { work(item.x0); });
+    }
+
+    //  ŸϿ  work(tile) մϴ. ȣ 嵵 ۾ 0 մϴ.
+    template <class Work>
+    void run(const Work& work) {
+        int num_workers = static_cast<int>(queues.size());
+        std::vector<std::thread> workers;
+        for (int id = 1; id < num_workers; ++id) {
+            workers.emplace_back([this, id, &work]() { workerLoop(id, work); });
+        }
+        workerLoop(0, work);
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Tile> tiles;
+    };
+    std::vector<WorkQueue> queues;
+
+    template <class Work>
+    void workerLoop(int id, const Work& work) {
+        Tile tile;
+        while (pop(id, tile) || steal(id, tile)) {
+            work(tile);
+        }
+    }
+
+    // ڱ ť ʿ Ÿ ϴ.
+    bool pop(int id, Tile& tile) {
+        WorkQueue& queue = queues[id];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tiles.empty()) {
+            return false;
+        }
+        tile = queue.tiles.back();
+        queue.tiles.pop_back();
+        return true;
+    }
+
+    // ٸ  ť (  ʰ ó Ÿ) Ŀɴϴ.
+    bool steal(int id, Tile& tile) {
+        int num_queues = static_cast<int>(queues.size());
+        for (int k = 1; k < num_queues; ++k) {
+            WorkQueue& victim = queues[(id + k) % num_queues];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tiles.empty()) {
+                tile = victim.tiles.front();
+                victim.tiles.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// -------------------------------------------------
+// ŸϺ  
+//
+//     ִ    δ ڸ ȭ鿡  ġ Ÿ ã, Ÿϸ  Ÿ
+//   ִ  ȣ  ϴ. 1     ȼ ⿡ Ƿ  ŸϿ  ʴ
+//  Ÿ     ʽϴ.  ó ׸  ڱ Ÿ ϸ    ü
+//   ƴ϶ ȭ ġ  е մϴ.    ī޶ 鿡 ģ   ŸϿ ϴ.
+
+//   ڸ ȭ鿡  ȼ ǥ  bounds (x0, x1, y0, y1) ϴ.
+// ڰ ī޶  ڷ Ѿ  谡 ƴϹǷ false ȯմϴ.
+bool projectBox(const Camera& camera, const AABB& box, int width, int height, float* bounds) {
+    float lo_x = INFINITY, hi_x = -INFINITY, lo_y = INFINITY, hi_y = -INFINITY;
+    for (int corner = 0; corner < 8; ++corner) {
+        vec3 p((corner & 1) ? box.hi.x : box.lo.x, (corner & 2) ? box.hi.y : box.lo.y, (corner & 4) ? box.hi.z : box.lo.z);
+        vec3 q = p - camera.eye;
+        float depth = -dot(q, camera.w);
+        if (depth <= 1e-6f) {
+            return false;
+        }
+        // getSampleRay : ̹  ǥ -> ȼ ǥ
+        float x = (camera.d * dot(q, camera.u) / depth - camera.l) / (camera.r - camera.l) * width;
+        float y = (camera.d * dot(q, camera.v) / depth - camera.b) / (camera.t - camera.b) * height;
+        lo_x = std::min(lo_x, x);
+        hi_x = std::max(hi_x, x);
+        lo_y = std::min(lo_y, y);
+        hi_y = std::max(hi_y, y);
+    }
+    bounds[0] = lo_x;
+    bounds[1] = hi_x;
+    bounds[2] = lo_y;
+    bounds[3] = hi_y;
+    return true;
+}
+
+// ȼ ǥ  bounds margin ȼŭ  ġ Ÿ  rect (x0, x1, y0, y1) ٲߴϴ.     ֽϴ.
+void tileRect(const float* bounds, float margin, int tile_size, int tiles_x, int tiles_y, int* rect) {
+    //  ٲٱ  Ÿ  ߶ ſ ū  ȯ 
+    float size = static_cast<float>(tile_size);
+    rect[0] = static_cast<int>(std::min(std::max(std::floor((bounds[0] - margin) / size), 0.0f), static_cast<float>(tiles_x)));
+    rect[1] = static_cast<int>(std::min(std::max(std::floor((bounds[1] + margin) / size) + 1.0f, 0.0f), static_cast<float>(tiles_x)));
+    rect[2] = static_cast<int>(std::min(std::max(std::floor((bounds[2] - margin) / size), 0.0f), static_cast<float>(tiles_y)));
+    rect[3] = static_cast<int>(std::min(std::max(std::floor((bounds[3] + margin) / size) + 1.0f, 0.0f), static_cast<float>(tiles_y)));
+}
+
+// LightGrid Ŭ: ŸϺ   Ÿ  ̾ ٿ մϴ (Ÿ k  ids[offsets[k] .. offsets[k + 1])).
+class LightGrid {
+public:
+    LightGrid() : tiles_x(0), tiles_y(0), tile_size(1) {}
+
+    // margin Ÿ   ǥ(籸  )  ȼ Դϴ.
+    void build(const Scene& scene, int width, int height, int tile_size, float margin) {
+        this->tile_size = tile_size;
+        tiles_x = (width + tile_size - 1) / tile_size;
+        tiles_y = (height + tile_size - 1) / tile_size;
+        int num_lights = static_cast<int>(scene.lights.size());
+        std::vector<int> rects(static_cast<size_t>(num_lights) * 4); //  Ÿ  [x0, x1) x [y0, y1)
+        offsets.assign(static_cast<size_t>(tiles_x) * tiles_y + 1, 0);
+        for (int k = 0; k < num_lights; ++k) {
+            int* rect = &rects[static_cast<size_t>(k) * 4];
+            tileRange(scene.camera, scene.lights[k], width, height, margin, rect);
+            for (int ty = rect[2]; ty < rect[3]; ++ty) {
+                for (int tx = rect[0]; tx < rect[1]; ++tx) {
+                    ++offsets[ty * tiles_x + tx + 1];
+                }
+            }
+        }
+        for (size_t k = 1; k < offsets.size(); ++k) {
+            offsets[k] += offsets[k - 1];
+        }
+        ids.resize(offsets.back());
+        std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+        for (int k = 0; k < num_lights; ++k) {
+            const int* rect = &rects[static_cast<size_t>(k) * 4];
+            for (int ty = rect[2]; ty < rect[3]; ++ty) {
+                for (int tx = rect[0]; tx < rect[1]; ++tx) {
+                    ids[fill[ty * tiles_x + tx]++] = k;
+                }
+            }
+        }
+    }
+
+    // TileScheduler  Ÿ  
+    LightList tileLights(const Tile& tile) const {
+        return lightsAt(tile.x0, tile.y0);
+    }
+
+    // ȼ (x, y)  Ÿ  
+    LightList lightsAt(int x, int y) const {
+        int k = (y / tile_size) * tiles_x + x / tile_size;
+        LightList list = { ids.data() + offsets[k], offsets[k + 1] - offsets[k] };
+        return list;
+    }
+
+    //   Ÿ  
+    int maxCount() const {
+        int count = 0;
+        for (size_t k = 1; k < offsets.size(); ++k) {
+            count = std::max(count, offsets[k] - offsets[k - 1]);
+        }
+        return count;
+    }
+
+private:
+    int tiles_x, tiles_y, tile_size;
+    std::vector<int> offsets;
+    std::vector<int> ids;
+
+    //     ִ Ÿ  rect (x0, x1, y0, y1) ϴ.     ֽϴ.
+    void tileRange(const Camera& camera, const Light& light, int width, int height, float margin, int* rect) const {
+        rect[0] = 0;
+        rect[1] = tiles_x;
+        rect[2] = 0;
+        rect[3] = tiles_y;
+        if (light.range <= 0.0f) {
+            return;
+        }
+        AABB box(light.position - vec3(light.range), light.position + vec3(light.range));
+        float bounds[4];
+        if (projectBox(camera, box, width, height, bounds)) { // ī޶  ڷ Ѿ ڴ  ŸϿ 
+            tileRect(bounds, margin, tile_size, tiles_x, tiles_y, rect);
+        }
+    }
+};
+
+// -------------------------------------------------
+// ȼ  
+//
+// RecordPixelCost    ΰ ȼ   PixelCost ϰ, 帮   
+//    Ʈ ̹ մϴ.  ð ð()̰ų, RENDER_STATS 忡  ˻
+// BVH  湮  ܰ Դϴ. 2x2    ȿ ο Ȱ  ݴϴ.  
+// ȼ б ϳ ϴ.
+
+enum class CostMetric {
+    Time, // ȼ 
+    Steps // ȼ  ˻ + BVH  湮 (RENDER_STATS  )
+};
+
+bool RecordPixelCost = false;
+CostMetric PixelCostMetric = CostMetric::Time;
+std::vector<float> PixelCost; // Width * Height, Ʒ  (OutputImage  Ծ)
+
+//    .     ̰  ̿  Դϴ.
+inline double pixelCostNow() {
+#if RENDER_STATS
+    if (PixelCostMetric == CostMetric::Steps) {
+        const uint64_t* counters = threadStats().counters;
+        return static_cast<double>(counters[STAT_SPHERE_TESTS] + counters[STAT_PLANE_TESTS]
+            + counters[STAT_TRIANGLE_TESTS] + counters[STAT_BVH_NODES]);
+    }
+#endif
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void recordPixelCost(int x, int y, double cost) {
+    PixelCost[static_cast<size_t>(y) * Width + x] = static_cast<float>(cost);
+}
+
+// -------------------------------------------------
+// G-buffer
+//
+// PrimaryGBuffer    ΰ ȼ 1  ġ, ,  ȣ, ̸ մϴ.
+//  űų  ٲ  1 ü ״̹Ƿ reshade()  ٽ  ʰ ϵ 
+//  ó ׸  ٽ մϴ.    ó  Ͱ ϴ. , ī޶,
+// ػ󵵰 ٲų  Ƽϸ  (ȼ ǥ ġ ٸ) ȿ Ǿ ٽ մϴ.
+
+// GBuffer Ŭ: ȼ 1  ϳ (  ȼ material_id -1)
+class GBuffer {
+public:
+    bool enabled; //  ΰ  
+
+    GBuffer() : enabled(false), valid(false), width(0), height(0), scene(nullptr), geometry_version(0),
+        camera(vec3(0.0f), vec3(0.0f), vec3(0.0f), vec3(0.0f), 0.0f, 0.0f, 0.0f, 0.0f, 0.0f) {}
+
+    //    θϴ. finish() θ  ȿԴϴ.
+    void begin(const Scene& scene) {
+        valid = false;
+        width = Width;
+        height = Height;
+        this->scene = &scene;
+        geometry_version = scene.geometryVersion();
+        camera = scene.camera;
+        points.resize(static_cast<size_t>(Width) * Height);
+    }
+
+    //  ȼ   θϴ.
+    void finish() {
+        valid = true;
+    }
+
+    void invalidate() {
+        valid = false;
+    }
+
+    // ϵ   scene ػ󵵿 ״ ȿ Ȯմϴ.
+    bool matches(const Scene& scene) const {
+        return recorded(scene) && geometry_version == scene.geometryVersion();
+    }
+
+    // scene  ī޶ ػ󵵷 ϸ ߴ Ȯմϴ (   ٲ  ).
+    bool recorded(const Scene& scene) const {
+        return valid && this->scene == &scene && width == Width && height == Height && sameCamera(camera, scene.camera);
+    }
+
+    // point nullptr̸   ȼԴϴ.
+    void store(int x, int y, const ShadingPoint* point) {
+        ShadingPoint& slot = points[static_cast<size_t>(y) * width + x];
+        if (point) {
+            slot = *point;
+        }
+        else {
+            slot.material_id = -1;
+        }
+    }
+
+    const ShadingPoint& at(int x, int y) const {
+        return points[static_cast<size_t>(y) * width + x];
+    }
+
+private:
+    bool valid;
+    int width, height;
+    const Scene* scene;
+    unsigned geometry_version;
+    Camera camera;
+    std::vector<ShadingPoint> points; // width * height, Ʒ  (OutputImage  Ծ)
+};
+
+GBuffer PrimaryGBuffer;
+
+// -------------------------------------------------
+// ŸϺ  
+//
+// FrameDependencies    ΰ Ÿϸ 1   ڸ մϴ. ݻ簡 Ƿ
+// ȼ   ȼ 1   ,  Ÿ   ׸   
+// մϴ.   API   (    ) renderDirty()
+//   -  ȭ鿡 Ǵ Ÿ (  ̴   ڿ  )
+//   -    Ÿ   ̸   ִ Ÿ (  ׸)
+//  ٽ մϴ. ׸        ġ  麸  
+//  մϴ. ī޶, ػ,  ٲų setMaterial() ҷ ü ٽ մϴ.
+
+// TileDependencies Ŭ: Ÿϸ 1    (  Ÿ  )
+class TileDependencies {
+public:
+    bool enabled; //  ΰ  
+
+    TileDependencies() : enabled(false), valid(false), width(0), height(0), tiles_x(0), tiles_y(0), scene(nullptr), material_version(0),
+        camera(vec3(0.0f), vec3(0.0f), vec3(0.0f), vec3(0.0f), 0.0f, 0.0f, 0.0f, 0.0f, 0.0f) {}
+
+    // ü    θϴ. finish() θ  ȿԴϴ.
+    void begin(const Scene& scene) {
+        valid = false;
+        width = Width;
+        height = Height;
+        tiles_x = (Width + TILE_SIZE - 1) / TILE_SIZE;
+        tiles_y = (Height + TILE_SIZE - 1) / TILE_SIZE;
+        hit_bounds.assign(static_cast<size_t>(tiles_x) * tiles_y, AABB());
+        stamp(scene);
+    }
+
+    void finish() {
+        valid = true;
+    }
+
+    void invalidate() {
+        valid = false;
+    }
+
+    //  ó ٽ  (reshade)     ϴ.
+    void stamp(const Scene& scene) {
+        this->scene = &scene;
+        camera = scene.camera;
+        lights = scene.lights;
+        material_version = scene.materialVersion();
+    }
+
+    // scene  ī޶ ػ󵵷 ϸ ߴ Ȯմϴ (    ٲ  ).
+    bool recorded(const Scene& scene) const {
+        return valid && this->scene == &scene && width == Width && height == Height && sameCamera(camera, scene.camera);
+    }
+
+    //  Ӱ scene ̰   Ȯմϴ.
+    bool matches(const Scene& scene) const {
+        if (!recorded(scene) || material_version != scene.materialVersion() || lights.size() != scene.lights.size()) {
+            return false;
+        }
+        for (size_t k = 0; k < lights.size(); ++k) {
+            const Light& a = lights[k];
+            const Light& b = scene.lights[k];
+            if (a.position != b.position || a.color != b.color || a.range != b.range || a.direction != b.direction
+                || a.cos_inner != b.cos_inner || a.cos_outer != b.cos_outer) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // ȼ (x, y) 1  Ÿ ڿ ֽϴ. Ÿ  常 ϹǷ  ʿ ϴ.
+    void record(int x, int y, const vec3& point) {
+        hit_bounds[(y / TILE_SIZE) * tiles_x + x / TILE_SIZE].expand(point);
+    }
+
+    // ٽ ϱ  Ÿ  ϴ.
+    void clear(const Tile& tile) {
+        hit_bounds[(tile.y0 / TILE_SIZE) * tiles_x + tile.x0 / TILE_SIZE] = AABB();
+    }
+
+    // scene      ִ Ÿ . light_grid    ŸϺ  Դϴ.
+    std::vector<Tile> affectedTiles(const Scene& scene, const LightGrid& light_grid) const {
+        std::vector<char> marked(hit_bounds.size(), 0);
+        for (const EditRegion& region : scene.editRegions()) {
+            //  ̴ Ÿ. ȼ ߽ɸ  ݿø   1ȼ  
+            float bounds[4];
+            int rect[4] = { 0, tiles_x, 0, tiles_y };
+            if (projectBox(scene.camera, region.box, width, height, bounds)) {
+                tileRect(bounds, 1.0f, TILE_SIZE, tiles_x, tiles_y, rect);
+            }
+            for (int ty = rect[2]; ty < rect[3]; ++ty) {
+                for (int tx = rect[0]; tx < rect[1]; ++tx) {
+                    marked[ty * tiles_x + tx] = 1;
+                }
+            }
+            if (!region.shadows) {
+                continue;
+            }
+            //  ׸ڸ 帮  ִ Ÿ
+            for (int k = 0; k < static_cast<int>(hit_bounds.size()); ++k) {
+                const AABB& receivers = hit_bounds[k];
+                if (marked[k] || receivers.lo.x > receivers.hi.x) {
+                    continue;
+                }
+                LightList list = light_grid.lightsAt((k % tiles_x) * TILE_SIZE, (k / tiles_x) * TILE_SIZE);
+                for (int slot = 0; slot < list.count; ++slot) {
+                    const Light& light = scene.lights[list.ids[slot]];
+                    if (mayShadow(light.position, region.box, receivers)) {
+                        marked[k] = 1;
+                        break;
+                    }
+                }
+            }
+        }
+        std::vector<Tile> tiles;
+        for (int k = 0; k < static_cast<int>(marked.size()); ++k) {
+            if (marked[k]) {
+                Tile tile;
+                tile.x0 = (k % tiles_x) * TILE_SIZE;
+                tile.y0 = (k / tiles_x) * TILE_SIZE;
+                tile.x1 = std::min(tile.x0 + TILE_SIZE, width);
+                tile.y1 = std::min(tile.y0 + TILE_SIZE, height);
+                tiles.push_back(tile);
+            }
+        }
+        return tiles;
+    }
+
+private:
+    bool valid;
+    int width, height, tiles_x, tiles_y;
+    const Scene* scene;
+    unsigned material_version;
+    Camera camera;
+    std::vector<Light> lights;
+    std::vector<AABB> hit_bounds; // tiles_x * tiles_y
+
+    // light receivers     occluder    true.
+    //  ڸ   ٲ,     þ߰ ġ occluder receivers    ִ ϴ.
+    static bool mayShadow(const vec3& light, const AABB& occluder, const AABB& receivers) {
+        const float slack = 0.01f; // ׸   ° ݿø 
+        vec3 to_occluder = occluder.centroid() - light;
+        vec3 to_receivers = receivers.centroid() - light;
+        float occluder_radius = length(occluder.hi - occluder.lo) * 0.5f + slack;
+        float receivers_radius = length(receivers.hi - receivers.lo) * 0.5f + slack;
+        float occluder_dist = length(to_occluder);
+        float receivers_dist = length(to_receivers);
+        if (occluder_dist <= occluder_radius || receivers_dist <= receivers_radius) {
+            return true; //    ȿ 
+        }
+        if (occluder_dist - occluder_radius >= receivers_dist + receivers_radius) {
+            return false; // occluder    
+        }
+        float cos_angle = dot(to_occluder, to_receivers) / (occluder_dist * receivers_dist);
+        float angle = std::acos(std::min(std::max(cos_angle, -1.0f), 1.0f));
+        return angle <= std::asin(occluder_radius / occluder_dist) + std::asin(receivers_radius / receivers_dist) + 1e-3f;
+    }
+};
+
+TileDependencies FrameDependencies;
+
+// ȼ (x, y) 1   ִ G-buffer ŸϺ   մϴ (point nullptr̸  ).
+inline void recordPrimary(int x, int y, const ShadingPoint* point) {
+    if (PrimaryGBuffer.enabled) {
+        PrimaryGBuffer.store(x, y, point);
+    }
+    if (FrameDependencies.enabled && point) {
+        FrameDependencies.record(x, y, point->position);
+    }
+}
+
+// ü  ϱ   ִ   scene ǥմϴ.      ݿմϴ.
+inline void beginPrimaryRecords(Scene& scene) {
+    PrimaryGBuffer.invalidate();
+    FrameDependencies.invalidate();
+    if (PrimaryGBuffer.enabled) {
+        PrimaryGBuffer.begin(scene);
+    }
+    if (FrameDependencies.enabled) {
+        FrameDependencies.begin(scene);
+    }
+    scene.clearEdits();
+}
+
+//  ȼ 1    θϴ.  Ƽϸ ȼ ǥ ġ ޶  Ƿ θ ʽϴ.
+inline void finishPrimaryRecords() {
+    if (PrimaryGBuffer.enabled) {
+        PrimaryGBuffer.finish();
+    }
+    if (FrameDependencies.enabled) {
+        FrameDependencies.finish();
+    }
+}
+
+// 1    óϰ recordPrimary  մϴ.
+inline vec3 shadePrimary(const Scene& scene, const Ray& ray, const Hit& hit, const LightList& lights, int x, int y) {
+    ShadingPoint point;
+    bool found = scene.surfacePoint(ray, hit, point);
+    recordPrimary(x, y, found ? &point : nullptr);
+    return found ? scene.shadePoint(point, lights) : vec3(0.0f, 0.0f, 0.0f);
+}
+
+// Ÿ ȼ ϳ մϴ. lights Ÿ  Դϴ.
+void renderTile(const Scene& scene, const Tile& tile, const LightList& lights) {
+    for (int j = tile.y0; j < tile.y1; ++j) {
+        for (int i = tile.x0; i < tile.x1; ++i) {
+            double start = RecordPixelCost ? pixelCostNow() : 0.0;
+            Ray ray = scene.camera.getRay(i, j); // ī޶ ȼ ǥ  
+            STAT_ADD(STAT_PRIMARY_RAYS, 1);
+            Hit hit;
+            scene.intersect(ray, hit); //  
+            vec3 color = shadePrimary(scene, ray, hit, lights, i, j);
+            OutputImage.at(i, j) = color; // Ÿ ġ Ƿ   
+            if (RecordPixelCost) {
+                recordPixelCost(i, j, pixelCostNow() - start);
+            }
+        }
+    }
+}
+
+// Ÿ 2x2 ȼ  մϴ. ̿ ȼ 1    
+// BVH ȸ   4  Բ ϰ,  ó ȼ մϴ.
+void renderTilePacket(const Scene& scene, const Tile& tile, const LightList& lights) {
+    for (int j = tile.y0; j < tile.y1; j += 2) {
+        for (int i = tile.x0; i < tile.x1; i += 2) {
+            // ̹ ڸ   ȿ ȼ  ϰ  ϴ.
+            int px[4], py[4];
+            //      ϹǷ (i, j)     մϴ.
+            Ray first = scene.camera.getRay(i, j);
+            Ray rays[4] = { first, first, first, first };
+            px[0] = i;
+            py[0] = j;
+            for (int lane = 1; lane < 4; ++lane) {
+                px[lane] = i + (lane & 1);
+                py[lane] = j + (lane >> 1);
+                if (px[lane] < tile.x1 && py[lane] < tile.y1) {
+                    rays[lane] = scene.camera.getRay(px[lane], py[lane]);
+                }
+            }
+            double start = RecordPixelCost ? pixelCostNow() : 0.0;
+            RayPacket4 packet(rays);
+            PacketHit hit;
+            scene.intersect4(packet, hit);
+            double lane_cost = 0.0; //    κ 
+            if (RecordPixelCost) {
+                int lanes = (std::min(i + 2, tile.x1) - i) * (std::min(j + 2, tile.y1) - j);
+                lane_cost = (pixelCostNow() - start) / lanes;
+            }
+            for (int lane = 0; lane < 4; ++lane) {
+                if (px[lane] < tile.x1 && py[lane] < tile.y1) {
+                    double shade_start = RecordPixelCost ? pixelCostNow() : 0.0;
+                    STAT_ADD(STAT_PRIMARY_RAYS, 1);
+                    vec3 color = shadePrimary(scene, rays[lane], hit.lane(lane), lights, px[lane], py[lane]);
+                    OutputImage.at(px[lane], py[lane]) = color;
+                    if (RecordPixelCost) {
+                        recordPixelCost(px[lane], py[lane], lane_cost + pixelCostNow() - shade_start);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// -------------------------------------------------
+//  Ƽϸ
+//
+// ȼ  ȭ ǥ   ϰ, ֵ  ǥ  غ ũų ǥ  ٸ ü
+//  ȼ   ǥ    մϴ (ѱ). κ   ù  ϴ.
+// ǥ 籸    ü Ѹ    ϹǷ, ̿ ȼ ǥ ְ ʰ
+//  ͸   ֽϴ.
+
+enum class PixelFilter {
+    Box,     // ȼ  յ 
+    Tent,    //  1ȼ ﰢ 
+    Gaussian //  1.5ȼ þ (alpha = 2)
+};
+
+// AntiAliasing ü:   ǥ . base_samples 1̸ ȼ ߽  ϳ մϴ.
+struct AntiAliasing {
+    int base_samples; //  ȭ ǥ  (n x n ڰ ǵ  ø)
+    int max_samples;  // ȼ ǥ 
+    float threshold;  // ֵ  ǥ  
+    PixelFilter filter;
+
+    AntiAliasing() : base_samples(1), max_samples(64), threshold(0.01f), filter(PixelFilter::Tent) {}
+
+    bool enabled() const {
+        return base_samples > 1;
+    }
+
+    int grid() const {
+        int n = 1;
+        while (n * n < base_samples) {
+            ++n;
+        }
+        return n;
+    }
+
+    float filterRadius() const {
+        return filter == PixelFilter::Box ? 0.5f : filter == PixelFilter::Tent ? 1.0f : 1.5f;
+    }
+
+    // ȼ ߽ɿ (dx, dy)ŭ  ǥ ġ
+    float filterWeight(float dx, float dy) const {
+        switch (filter) {
+        case PixelFilter::Tent:
+            return std::max(0.0f, 1.0f - std::abs(dx)) * std::max(0.0f, 1.0f - std::abs(dy));
+        case PixelFilter::Gaussian: {
+            const float edge = std::exp(-2.0f * 1.5f * 1.5f); //    0 ǵ 
+            return std::max(0.0f, std::exp(-2.0f * dx * dx) - edge) * std::max(0.0f, std::exp(-2.0f * dy * dy) - edge);
+        }
+        default:
+            return 1.0f;
+        }
+    }
+};
+
+AntiAliasing OutputAntiAliasing;
+
+// ȼ ǥ ǥ ȣ    [0, 1).   Ÿ  ϰ  ̹ ϴ.
+inline float sampleRandom(int x, int y, int index, int dimension) {
+    uint32_t h = static_cast<uint32_t>(x) * 0x8da6b343u ^ static_cast<uint32_t>(y) * 0xd8163841u
+        ^ static_cast<uint32_t>(index * 2 + dimension) * 0xcb1ab31fu;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+//     ü(ǥ, , νϽ)  Ȯմϴ. ޽ ﰢ ȣ  ʽϴ.
+inline bool sameObject(const Hit& a, const Hit& b) {
+    return a.surface == b.surface && a.sphere == b.sphere && a.instance == b.instance;
+}
+
+// ȼ (i, j)  ǥȭ  ȯϰ,  ǥ  samples մϴ.
+vec3 renderPixelAdaptive(const Scene& scene, int i, int j, const AntiAliasing& aa, const LightList& lights, long long& samples) {
+    const int grid = aa.grid();
+    const int round_size = grid * grid;
+    const float radius = aa.filterRadius();
+    vec3 color_sum(0.0f);
+    float weight_sum = 0.0f;
+    float mean = 0.0f, m2 = 0.0f; // ֵ ¶ հ   (Welford)
+    Hit first_hit;
+    bool objects_differ = false;
+    int n = 0;
+    for (;;) {
+        for (int first = 0; first < round_size; first += 4) {
+            int count = std::min(4, round_size - first);
+            float dx[4], dy[4];
+            for (int k = 0; k < 4; ++k) {
+                int index = n + first + std::min(k, count - 1); //    ǥ 
+                int stratum = (first + std::min(k, count - 1)) % round_size;
+                float u = (stratum % grid + sampleRandom(i, j, index, 0)) / grid;
+                float v = (stratum / grid + sampleRandom(i, j, index, 1)) / grid;
+                dx[k] = (2.0f * u - 1.0f) * radius;
+                dy[k] = (2.0f * v - 1.0f) * radius;
+            }
+            Ray rays[4] = {
+                scene.camera.getSampleRay(i + 0.5f + dx[0], j + 0.5f + dy[0]), scene.camera.getSampleRay(i + 0.5f + dx[1], j + 0.5f + dy[1]),
+                scene.camera.getSampleRay(i + 0.5f + dx[2], j + 0.5f + dy[2]), scene.camera.getSampleRay(i + 0.5f + dx[3], j + 0.5f + dy[3])
+            };
+            Hit hits[4];
+            STAT_ADD(STAT_PRIMARY_RAYS, count);
+            if (UsePacketTracing) {
+                RayPacket4 packet(rays);
+                PacketHit packet_hit;
+                scene.intersect4(packet, packet_hit);
+                for (int k = 0; k < count; ++k) {
+                    hits[k] = packet_hit.lane(k);
+                }
+            }
+            else {
+                for (int k = 0; k < count; ++k) {
+                    scene.intersect(rays[k], hits[k]);
+                }
+            }
+            for (int k = 0; k < count; ++k) {
+                vec3 color = scene.shade(rays[k], hits[k], lights);
+                float weight = aa.filterWeight(dx[k], dy[k]);
+                color_sum += color * weight;
+                weight_sum += weight;
+                float luminance = dot(color, vec3(0.2126f, 0.7152f, 0.0722f));
+                int index = n + first + k + 1;
+                float delta = luminance - mean;
+                mean += delta / index;
+                m2 += delta * (luminance - mean);
+                if (index == 1) {
+                    first_hit = hits[k];
+                }
+                else if (!sameObject(first_hit, hits[k])) {
+                    objects_differ = true;
+                }
+            }
+        }
+        n += round_size;
+        float std_error = std::sqrt(m2 / (n - 1) / n);
+        if ((!objects_differ && std_error <= aa.threshold) || n + round_size > aa.max_samples) {
+            break;
+        }
+    }
+    samples += n;
+    return weight_sum > 0.0f ? color_sum / weight_sum : vec3(0.0f);
+}
+
+// Ÿ  ȼ  ǥȭմϴ.
+void renderTileAdaptive(const Scene& scene, const Tile& tile, const AntiAliasing& aa, const LightList& lights, std::atomic<long long>& samples) {
+    long long tile_samples = 0;
+    for (int j = tile.y0; j < tile.y1; ++j) {
+        for (int i = tile.x0; i < tile.x1; ++i) {
+            double start = RecordPixelCost ? pixelCostNow() : 0.0;
+            OutputImage.at(i, j) = renderPixelAdaptive(scene, i, j, aa, lights, tile_samples);
+            if (RecordPixelCost) {
+                recordPixelCost(i, j, pixelCostNow() - start);
+            }
+        }
+    }
+    samples += tile_samples;
+}
+
+// -------------------------------------------------
+// ̺Ʈ 
+//
+// ȼ  ->  -> ׸   켱 óϴ ,  ü  ܰ躰  óմϴ.
+//   1   ->  ->  غ(, , , ambient)
+//   -> [ Ը ׸   ->  ] -> 
+// ť  ü ũ SoA 迭̰,  4096  ûũ ޾   ܰ ʷ մϴ.
+// ܰ踶   Ŀθ  õ   Ƿ ڵ Ͱ ĳÿ ӹϴ.
+// 1  ť ٷ SSE  нϴ.
+// ׸   Ÿ   s°  ϳ ϴ. ׷ ť    ʰ,
+//   ϹǷ  켱 ο  ̹ ɴϴ.
+// ݻ  2    ť ܰ踦 ϸ ˴ϴ.
+// ȼ ǥ  ٸ  Ƽϸ Ÿ θ ״ ϴ.
+
+// FrameArena Ŭ:     ť ū Ͽ ʷ ߶ ִ Ҵ. reset() ޸𸮸  Ƿ
+// ػ󵵰   ° Ӻʹ Ҵ ϴ. ڸ θ Ƿ ܼ Ŀ ϴ.
+class FrameArena {
+public:
+    FrameArena() : used(0), frame_bytes(0) {}
+
+    template <class T>
+    T* allocate(size_t count) {
+        size_t bytes = (count * sizeof(T) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT + STAGGER;
+        if (blocks.empty() || used + bytes > blocks.back().size) {
+            addBlock(std::max(bytes, blocks.empty() ? size_t(1) << 20 : blocks.back().size * 2));
+        }
+        T* data = reinterpret_cast<T*>(blocks.back().data + used);
+        used += bytes;
+        frame_bytes += bytes;
+        return data;
+    }
+
+    //   ȣմϴ.    ʿ  ӿ   ϵ Ĩϴ.
+    void reset() {
+        if (blocks.size() > 1) {
+            blocks.clear();
+            addBlock(frame_bytes);
+        }
+        used = 0;
+        frame_bytes = 0;
+    }
+
+private:
+    static const size_t ALIGNMENT = 64; // ĳ  (SSE  б⵵ )
+    // 迭 ڿ δ  (ĳ  5). ť 迭 ũⰡ  2 ŵ  ̸  ȣ Ұ 
+    //  L1 տ Ƿ (4K aliasing), 迭  ĳ   ݾ ߳ մϴ.
+    static const size_t STAGGER = 5 * ALIGNMENT;
+
+    struct Block {
+        std::unique_ptr<char[]> storage;
+        char* data; // storage  ĵ 
+        size_t size;
+    };
+    std::vector<Block> blocks;
+    size_t used;        //  Ͽ  Ʈ
+    size_t frame_bytes; // ̹ ӿ Ҵ Ʈ
+
+    void addBlock(size_t size) {
+        Block block;
+        block.storage.reset(new char[size + ALIGNMENT]);
+        uintptr_t address = reinterpret_cast<uintptr_t>(block.storage.get());
+        block.data = block.storage.get() + (ALIGNMENT - address % ALIGNMENT) % ALIGNMENT;
+        block.size = size;
+        blocks.push_back(std::move(block));
+        used = 0;
+    }
+};
+
+FrameArena WavefrontArena;
+
+const int WAVEFRONT_TILES = 16; // 尡   ޴  Ÿ  (16x16 Ÿ̸  4096)
+
+// RayQueue ü:  ť (SoA). 1  payload ȼ ȣ(y * Width + x, ä  -1)̰,
+// ׸  payload     ť ȣԴϴ.
+struct RayQueue {
+    float *ox, *oy, *oz;
+    float *dx, *dy, *dz;
+    float *tmin, *tmax; //   (׸  )
+    int* payload;
+
+    void allocate(FrameArena& arena, int capacity) {
+        ox = arena.allocate<float>(capacity);
+        oy = arena.allocate<float>(capacity);
+        oz = arena.allocate<float>(capacity);
+        dx = arena.allocate<float>(capacity);
+        dy = arena.allocate<float>(capacity);
+        dz = arena.allocate<float>(capacity);
+        tmin = arena.allocate<float>(capacity);
+        tmax = arena.allocate<float>(capacity);
+        payload = arena.allocate<int>(capacity);
+    }
+
+    void set(int k, const Ray& ray, int value) {
+        ox[k] = ray.origin.x;
+        oy[k] = ray.origin.y;
+        oz[k] = ray.origin.z;
+        dx[k] = ray.direction.x;
+        dy[k] = ray.direction.y;
+        dz[k] = ray.direction.z;
+        tmin[k] = ray.tmin;
+        tmax[k] = ray.tmax;
+        payload[k] = value;
+    }
+
+    Ray ray(int k) const {
+        return Ray(vec3(ox[k], oy[k], oz[k]), vec3(dx[k], dy[k], dz[k]), tmin[k], tmax[k]);
+    }
+
+    // k 4  (k 4 )
+    RayPacket4 packet(int k) const {
+        RayPacket4 packet;
+        packet.ox = _mm_load_ps(ox + k);
+        packet.oy = _mm_load_ps(oy + k);
+        packet.oz = _mm_load_ps(oz + k);
+        packet.dx = _mm_load_ps(dx + k);
+        packet.dy = _mm_load_ps(dy + k);
+        packet.dz = _mm_load_ps(dz + k);
+        packet.tmin = _mm_load_ps(tmin + k);
+        return packet;
+    }
+};
+
+// ShadeQueue ü: 1  ť  ȣ     (SoA).     ׸񿡸 ϵ˴ϴ.
+struct ShadeQueue {
+    float *px, *py, *pz; // 
+    float *nx, *ny, *nz; // 
+    int* material;
+    float *r, *g, *b;    //  
+    // ׸   ʾ    (׸  ť  ȣ)
+    float *diffuse_r, *diffuse_g, *diffuse_b;
+    float *specular_r, *specular_g, *specular_b;
+
+    void allocate(FrameArena& arena, int capacity) {
+        float** arrays[] = { &px, &py, &pz, &nx, &ny, &nz, &r, &g, &b,
+            &diffuse_r, &diffuse_g, &diffuse_b, &specular_r, &specular_g, &specular_b };
+        for (float** array : arrays) {
+            *array = arena.allocate<float>(capacity);
+        }
+        material = arena.allocate<int>(capacity);
+    }
+};
+
+//  ̺Ʈ  OutputImage ϰ  1   ȯմϴ.
+long long renderWavefront(const Scene& scene, const LightGrid& light_grid) {
+    const int tiles_x = (Width + TILE_SIZE - 1) / TILE_SIZE;
+    const int tiles_y = (Height + TILE_SIZE - 1) / TILE_SIZE;
+
+    // 1  Ÿ , Ÿ ȿ renderTilePacket  2x2    ̿ 4    ˴ϴ.
+    std::vector<int> tile_offsets(static_cast<size_t>(tiles_x) * tiles_y + 1, 0);
+    for (int k = 0; k < tiles_x * tiles_y; ++k) {
+        int w = std::min(TILE_SIZE, Width - (k % tiles_x) * TILE_SIZE);
+        int h = std::min(TILE_SIZE, Height - (k / tiles_x) * TILE_SIZE);
+        tile_offsets[k + 1] = tile_offsets[k] + (w + 1) / 2 * ((h + 1) / 2) * 4;
+    }
+    const int count = tile_offsets.back();
+
+    FrameArena& arena = WavefrontArena;
+    RayQueue primary, shadow;
+    ShadeQueue shading;
+    primary.allocate(arena, count);
+    shadow.allocate(arena, count);
+    shading.allocate(arena, count);
+    Hit* hits = arena.allocate<Hit>(count);
+    LightList* light_lists = arena.allocate<LightList>(count);
+    int* active = arena.allocate<int>(count); //    ȣ (ûũ ڱ  ʺ ä)
+
+    // ûũ( Ÿ WAVEFRONT_TILES) ܰ ʷ մϴ. ûũ ť(  4096) ĳÿ  ִ
+    //   ܰ谡 а,  Ը  ü ٽ  ʽϴ.
+    const int num_tiles = tiles_x * tiles_y;
+    TileScheduler::runRange((num_tiles + WAVEFRONT_TILES - 1) / WAVEFRONT_TILES, renderThreadCount(), [&](int chunk) {
+        const int first_tile = chunk * WAVEFRONT_TILES;
+        const int last_tile = std::min(first_tile + WAVEFRONT_TILES, num_tiles);
+        const int first = tile_offsets[first_tile];
+        const int last = tile_offsets[last_tile];
+
+        // 1. 1  
+        {
+            STAT_SCOPE("wavefront generate");
+            int k = first;
+            for (int t = first_tile; t < last_tile; ++t) {
+                int x0 = (t % tiles_x) * TILE_SIZE, x1 = std::min(x0 + TILE_SIZE, Width);
+                int y0 = (t / tiles_x) * TILE_SIZE, y1 = std::min(y0 + TILE_SIZE, Height);
+                for (int j = y0; j < y1; j += 2) {
+                    for (int i = x0; i < x1; i += 2) {
+                        Ray fill = scene.camera.getRay(i, j); // ̹ ڸ   ȿ  
+                        for (int lane = 0; lane < 4; ++lane, ++k) {
+                            int x = i + (lane & 1);
+                            int y = j + (lane >> 1);
+                            if (x < x1 && y < y1) {
+                                primary.set(k, scene.camera.getRay(x, y), y * Width + x);
+                            }
+                            else {
+                                primary.set(k, fill, -1);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // 2. : ť 4 ξ  ȸ
+        {
+            STAT_SCOPE("wavefront intersect");
+            for (int k = first; k < last; k += 4) {
+                PacketHit packet_hit;
+                scene.intersect4(primary.packet(k), packet_hit);
+                for (int lane = 0; lane < 4; ++lane) {
+                    hits[k + lane] = packet_hit.lane(lane);
+                }
+            }
+        }
+
+        // 3.  غ: , ,  ϰ ambient  .  ִ  Ȱ Ͽ 
+        int active_count = 0;
+        {
+            STAT_SCOPE("wavefront shade");
+            for (int k = first; k < last; ++k) {
+                shading.r[k] = shading.g[k] = shading.b[k] = 0.0f;
+                if (primary.payload[k] < 0) {
+                    continue;
+                }
+                STAT_ADD(STAT_PRIMARY_RAYS, 1);
+                int pixel = primary.payload[k];
+                ShadingPoint point;
+                bool found = scene.surfacePoint(primary.ray(k), hits[k], point);
+                recordPrimary(pixel % Width, pixel / Width, found ? &point : nullptr);
+                if (!found) {
+                    continue;
+                }
+                STAT_ADD(STAT_SHADED_HITS, 1);
+                int material_id = point.material_id;
+                const vec3& ambient = scene.materials[material_id].ka;
+                shading.px[k] = point.position.x;
+                shading.py[k] = point.position.y;
+                shading.pz[k] = point.position.z;
+                shading.nx[k] = point.normal.x;
+                shading.ny[k] = point.normal.y;
+                shading.nz[k] = point.normal.z;
+                shading.material[k] = material_id;
+                shading.r[k] = ambient.r;
+                shading.g[k] = ambient.g;
+                shading.b[k] = ambient.b;
+                light_lists[k] = light_grid.lightsAt(pixel % Width, pixel / Width);
+                if (light_lists[k].count > 0 && scene.materials[material_id].model != ShadingModel::Ambient) {
+                    active[first + active_count++] = k;
+                }
+            }
+        }
+
+        // 4.  Ը Ȱ  ׸  ť     մϴ.
+        //         Ȱ Ͽ ϴ.
+        STAT_SCOPE("wavefront shadow");
+        for (int slot = 0; active_count > 0; ++slot) {
+            int shadow_count = 0;
+            int still_active = 0;
+            for (int a = first; a < first + active_count; ++a) {
+                int k = active[a];
+                const LightList& lights = light_lists[k];
+                if (slot + 1 < lights.count) {
+                    active[first + still_active++] = k;
+                }
+                const Light& light = scene.lights[lights.ids[slot]];
+                vec3 point(shading.px[k], shading.py[k], shading.pz[k]);
+                vec3 light_dir, diffuse, specular;
+                float light_distance;
+                if (!light.reaches(point, light_dir, light_distance)) {
+                    continue;
+                }
+                vec3 normal(shading.nx[k], shading.ny[k], shading.nz[k]);
+                Ray shadow_ray;
+                if (!scene.lightSample(light, point, normal, light_dir, light_distance, scene.materials[shading.material[k]],
+                    diffuse, specular, shadow_ray)) {
+                    continue;
+                }
+                int n = first + shadow_count++;
+                shadow.set(n, shadow_ray, k);
+                shading.diffuse_r[n] = diffuse.r;
+                shading.diffuse_g[n] = diffuse.g;
+                shading.diffuse_b[n] = diffuse.b;
+                shading.specular_r[n] = specular.r;
+                shading.specular_g[n] = specular.g;
+                shading.specular_b[n] = specular.b;
+            }
+            active_count = still_active;
+
+            for (int n = first; n < first + shadow_count; ++n) {
+                STAT_ADD(STAT_SHADOW_RAYS, 1);
+                if (scene.occluded(shadow.ray(n))) {
+                    continue;
+                }
+                int k = shadow.payload[n];
+                shading.r[k] += shading.diffuse_r[n];
+                shading.g[k] += shading.diffuse_g[n];
+                shading.b[k] += shading.diffuse_b[n];
+                shading.r[k] += shading.specular_r[n];
+                shading.g[k] += shading.specular_g[n];
+                shading.b[k] += shading.specular_b[n];
+            }
+        }
+
+        // 5. 
+        for (int k = first; k < last; ++k) {
+            int pixel = primary.payload[k];
+            if (pixel >= 0) {
+                OutputImage.at(pixel % Width, pixel / Width) = vec3(shading.r[k], shading.g[k], shading.b[k]);
+            }
+        }
+    });
+    arena.reset();
+    return static_cast<long long>(Width) * Height;
+}
+
+//  OutputImage ϰ  1 (ǥ)  ȯմϴ.
+long long render(Scene& scene) {
+    STAT_SCOPE("render");
+    scene.buildAccel();
+    OutputImage.resize(Width, Height); // ̸ Ҵ ۿ ȼ ġ ٷ ϴ
+    if (RecordPixelCost) {
+        PixelCost.assign(static_cast<size_t>(Width) * Height, 0.0f);
+    }
+    LightGrid light_grid;
+    light_grid.build(scene, Width, Height, TILE_SIZE, OutputAntiAliasing.filterRadius());
+    beginPrimaryRecords(scene);
+    if (UseWavefront && !OutputAntiAliasing.enabled()) {
+        long long traced = renderWavefront(scene, light_grid);
+        finishPrimaryRecords();
+        return traced;
+    }
+    TileScheduler scheduler(Width, Height, TILE_SIZE, renderThreadCount());
+    if (OutputAntiAliasing.enabled()) {
+        std::atomic<long long> samples(0);
+        scheduler.run([&scene, &light_grid, &samples](const Tile& tile) {
+            STAT_SCOPE("tile", tile.x0, tile.y0);
+            renderTileAdaptive(scene, tile, OutputAntiAliasing, light_grid.tileLights(tile), samples);
+        });
+        return samples;
+    }
+    scheduler.run([&scene, &light_grid](const Tile& tile) {
+        STAT_SCOPE("tile", tile.x0, tile.y0);
+        if (UsePacketTracing) {
+            renderTilePacket(scene, tile, light_grid.tileLights(tile));
+        }
+        else {
+            renderTile(scene, tile, light_grid.tileLights(tile));
+        }
+    });
+    finishPrimaryRecords();
+    return static_cast<long long>(Width) * Height;
+}
+
+//      API ٲ κи ٽ ϰ ٽ  ȼ  ȯմϴ.
+// FrameDependencies  ä   ־ ϸ,   𸣰ų( ǥ)   
+// (ī޶, ػ, , ) ְų  Ƽϸ   render() ü ٽ մϴ.
+long long renderDirty(Scene& scene) {
+    if (!FrameDependencies.matches(scene) || scene.editedAll() || OutputAntiAliasing.enabled()) {
+        return render(scene);
+    }
+    STAT_SCOPE("render dirty");
+    scene.buildAccel();
+    LightGrid light_grid;
+    light_grid.build(scene, Width, Height, TILE_SIZE, OutputAntiAliasing.filterRadius());
+    std::vector<Tile> tiles = FrameDependencies.affectedTiles(scene, light_grid);
+    scene.clearEdits();
+    // ٽ  ʴ Ÿ 1  ״̹Ƿ G-buffer     ȿϰ ̾
+    bool keep_gbuffer = PrimaryGBuffer.recorded(scene);
+    if (PrimaryGBuffer.enabled) {
+        PrimaryGBuffer.begin(scene);
+    }
+    // ٽ ϴ Ÿ  ΰ ȼ  ,  ȼ  ȼ    
+    if (RecordPixelCost && PixelCost.size() != static_cast<size_t>(Width) * Height) {
+        PixelCost.assign(static_cast<size_t>(Width) * Height, 0.0f);
+    }
+    long long traced = 0;
+    for (const Tile& tile : tiles) {
+        FrameDependencies.clear(tile);
+        traced += static_cast<long long>(tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+    }
+    TileScheduler scheduler(tiles, renderThreadCount());
+    scheduler.run([&scene, &light_grid](const Tile& tile) {
+        STAT_SCOPE("tile", tile.x0, tile.y0);
+        if (UsePacketTracing) {
+            renderTilePacket(scene, tile, light_grid.tileLights(tile));
+        }
+        else {
+            renderTile(scene, tile, light_grid.tileLights(tile));
+        }
+    });
+    if (keep_gbuffer) {
+        PrimaryGBuffer.finish();
+    }
+    return traced;
+}
+
+// ̳  ٲ  PrimaryGBuffer  ٽ  ó OutputImage ϴ.
+// G-buffer scene   ƹ͵  ʰ false ȯϸ, ̶ render() ٽ ؾ մϴ.
+// cancelled ־ Ÿϸ Ȯ   Ÿ ǳʶٰ, ȭ Ϻθ ٲǷ false ȯմϴ.
+bool reshade(const Scene& scene, const std::atomic<bool>* cancelled = nullptr) {
+    if (!PrimaryGBuffer.matches(scene)) {
+        return false;
+    }
+    STAT_SCOPE("reshade");
+    LightGrid light_grid;
+    light_grid.build(scene, Width, Height, TILE_SIZE, 0.0f); // ǥ ȼ ߽ɻ̹Ƿ  ʿ 
+    OutputImage.resize(Width, Height);
+    TileScheduler scheduler(Width, Height, TILE_SIZE, renderThreadCount());
+    scheduler.run([&scene, &light_grid, cancelled](const Tile& tile) {
+        if (cancelled && *cancelled) {
+            return;
+        }
+        STAT_SCOPE("tile", tile.x0, tile.y0);
+        LightList lights = light_grid.tileLights(tile);
+        for (int j = tile.y0; j < tile.y1; ++j) {
+            for (int i = tile.x0; i < tile.x1; ++i) {
+                const ShadingPoint& point = PrimaryGBuffer.at(i, j);
+                OutputImage.at(i, j) = point.material_id >= 0 ? scene.shadePoint(point, lights) : vec3(0.0f, 0.0f, 0.0f);
+            }
+        }
+    });
+    if (cancelled && *cancelled) {
+        return false;
+    }
+    if (FrameDependencies.recorded(scene)) {
+        FrameDependencies.stamp(scene); // ȭ ü    ٽ ĥ
+    }
+    return true;
+}
+
+// -------------------------------------------------
+// ȭ  ó:  ۴ ״ ΰ Ź   ϹǷ ٽ  ʰ   ٲ  ֽϴ.
+
+enum class ToneOperator {
+    None,     // Ŭ
+    Reinhard, // x / (1 + x)
+    ACES      // ACES filmic ٻ (Narkowicz 2015)
+};
+
+// ToneMapper Ŭ:      [0, 1] Ŭ   2.2 Ǵ sRGB ڵ   մϴ.
+// ä 4 SSE ϰ, ȼ pow θ  sqrt(x)   ǥ   ڵմϴ.
+// (x^(1/2.2) 0 ó Ⱑ Ѵ x  ǥ ο   ũ, u = sqrt(x) ࿡ u^0.91  )
+class ToneMapper {
+public:
+    float exposure;
+    ToneOperator tone_operator;
+    bool srgb; // false  2.2
+
+    ToneMapper() : exposure(1.0f), tone_operator(ToneOperator::None), srgb(false) {
+        buildTable();
+    }
+
+    // linear ü display ȯմϴ.      Բ óմϴ.
+    void apply(const Framebuffer& linear, Framebuffer& display) {
+        STAT_SCOPE("tonemap");
+        updateTable();
+        display.resize(linear.width, linear.height);
+        TileScheduler scheduler(linear.width, linear.height, TILE_SIZE, renderThreadCount());
+        scheduler.run([&](const Tile& tile) {
+            for (int j = tile.y0; j < tile.y1; ++j) {
+                const float* in = &linear.at(tile.x0, j).x;
+                float* out = &display.at(tile.x0, j).x;
+                mapSpan(in, out, (tile.x1 - tile.x0) * 3);
+            }
+        });
+    }
+
+    //  ϳ ȯմϴ (mapSpan  ).
+    float map(float x) {
+        updateTable();
+        float in[4] = { x, 0.0f, 0.0f, 0.0f };
+        float out[4];
+        map4(in, out);
+        return out[0];
+    }
+
+private:
+    static const int TABLE_SIZE = 1024;
+    float table[TABLE_SIZE + 1]; // table[k] = encode((k / TABLE_SIZE)^2)
+    bool lut_srgb;               // ǥ  ڵ (srgb ٸ ٽ )
+
+    void updateTable() {
+        if (lut_srgb != srgb) {
+            buildTable();
+        }
+    }
+
+    void buildTable() {
+        for (int k = 0; k <= TABLE_SIZE; ++k) {
+            float u = static_cast<float>(k) / TABLE_SIZE;
+            float x = u * u;
+            if (srgb) {
+                table[k] = x <= 0.0031308f ? 12.92f * x : 1.055f * std::pow(x, 1.0f / 2.4f) - 0.055f;
+            }
+            else {
+                table[k] = std::pow(x, 1.0f / 2.2f);
+            }
+        }
+        lut_srgb = srgb;
+    }
+
+    void mapSpan(const float* in, float* out, int count) const {
+        int k = 0;
+        for (; k + 4 <= count; k += 4) {
+            map4(in + k, out + k);
+        }
+        if (k < count) { //  1~3 ӽ 迭   
+            float tail_in[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            float tail_out[4];
+            std::copy(in + k, in + count, tail_in);
+            map4(tail_in, tail_out);
+            std::copy(tail_out, tail_out + (count - k), out + k);
+        }
+    }
+
+    void map4(const float* in, float* out) const {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        __m128 x = _mm_mul_ps(_mm_loadu_ps(in), _mm_set1_ps(exposure));
+        if (tone_operator == ToneOperator::Reinhard) {
+            x = _mm_div_ps(x, _mm_add_ps(one, x));
+        }
+        else if (tone_operator == ToneOperator::ACES) {
+            __m128 num = _mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(2.51f)), _mm_set1_ps(0.03f)));
+            __m128 den = _mm_add_ps(_mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(2.43f)), _mm_set1_ps(0.59f))), _mm_set1_ps(0.14f));
+            x = _mm_div_ps(num, den);
+        }
+        x = _mm_min_ps(_mm_max_ps(x, zero), one); // NaN 0 
+        float pos[4];
+        _mm_storeu_ps(pos, _mm_mul_ps(_mm_sqrt_ps(x), _mm_set1_ps(static_cast<float>(TABLE_SIZE))));
+        for (int lane = 0; lane < 4; ++lane) {
+            int index = std::min(static_cast<int>(pos[lane]), TABLE_SIZE - 1);
+            float frac = pos[lane] - index;
+            out[lane] = table[index] + (table[index + 1] - table[index]) * frac;
+        }
+    }
+};
+
+ToneMapper OutputToneMapper;
+
+// -------------------------------------------------
+//   (â )
+
+// ù н 8x8 ȼ ϸ  ȼ   ü ĥϰ,  н   Դϴ.
+const int COARSEST_BLOCK = 8;
+static_assert(TILE_SIZE % COARSEST_BLOCK == 0, "tiles must be aligned to the coarsest progressive block");
+
+// Ÿ ȿ block  ȼ  block x block    ĥմϴ.
+// ù н ƴϸ  н(2 * block ) ̹  ȼ ǳʶٹǷ  ȼ   ˴ϴ.
+void renderTileBlocks(const Scene& scene, const Tile& tile, const LightList& lights, int block, bool first_pass) {
+    for (int j = tile.y0; j < tile.y1; j += block) {
+        for (int i = tile.x0; i < tile.x1; i += block) {
+            if (!first_pass && i % (2 * block) == 0 && j % (2 * block) == 0) {
+                continue;
+            }
+            Ray ray = scene.camera.getRay(i, j);
+            STAT_ADD(STAT_PRIMARY_RAYS, 1);
+            Hit hit;
+            scene.intersect(ray, hit);
+            vec3 color = shadePrimary(scene, ray, hit, lights, i, j);
+            for (int y = j; y < std::min(j + block, tile.y1); ++y) {
+                for (int x = i; x < std::min(i + block, tile.x1); ++x) {
+                    OutputImage.at(x, y) = color;
+                }
+            }
+        }
+    }
+}
+
+// ProgressiveRenderer Ŭ: ׶ 忡 ģ ػ󵵺  ػ󵵱 н  մϴ.
+// н     ̹ ѱ,   GLFW   ̹ ȭ鿡  ݴϴ.
+class ProgressiveRenderer {
+public:
+    explicit ProgressiveRenderer(Scene& scene) : scene(scene), cancelled(false), running(false), frames(0) {}
+
+    ~ProgressiveRenderer() {
+        cancel();
+    }
+
+    //  Width x Height  մϴ.      մϴ.
+    void start() {
+        cancel();
+        scene.buildAccel();
+        light_grid.build(scene, Width, Height, TILE_SIZE, OutputAntiAliasing.filterRadius());
+        OutputImage.resize(Width, Height);
+        OutputImage.clear(vec3(0.0f));
+        beginPrimaryRecords(scene);
+        cancelled = false;
+        running = true;
+        worker = std::thread([this]() { run(); });
+    }
+
+    // ̳  ٲ  θϴ.    G-buffer ä  ó ٽ ϰ,
+    // ƴϸ ó ٽ մϴ.
+    void relight() {
+        cancel();
+        if (!PrimaryGBuffer.matches(scene)) {
+            start();
+            return;
+        }
+        cancelled = false;
+        running = true;
+        worker = std::thread([this]() {
+            if (reshade(scene, &cancelled)) { // ҵǸ  ĥ ȭ ѱ 
+                publish();
+            }
+            running = false;
+        });
+    }
+
+    //    ߰ ۾ 尡   ٸϴ.
+    // Width, Height, OutputImage ٲٱ  ݵ ȣؾ մϴ.
+    void cancel() {
+        cancelled = true;
+        if (worker.joinable()) {
+            worker.join();
+        }
+        running = false;
+    }
+
+    bool isRunning() const {
+        return running;
+    }
+
+    // н ٽ  ó ϳ   1 þ ȣ. ȭ   ٲ  ٽ øϴ.
+    // ۾  running     øǷ, isRunning()  а     ̹ ġ ʽϴ.
+    unsigned frameCount() const {
+        return frames;
+    }
+
+    //   н   DisplayImage  ä use(DisplayImage) θϴ.
+    // ۾  OutputImage  Ƿ ȭ  OutputImage  ̰͸ о մϴ.
+    template <class Use>
+    void withDisplay(Use use) {
+        std::lock_guard<std::mutex> lock(display_mutex);
+        use(static_cast<const Framebuffer&>(DisplayImage));
+    }
+
+    //  ٲٱ  cancel() ҷ մϴ.
+    Scene& getScene() {
+        return scene;
+    }
+
+private:
+    Scene& scene;
+    LightGrid light_grid; // start()  ۾  б⸸ 
+    std::thread worker;
+    std::atomic<bool> cancelled;
+    std::atomic<bool> running;
+    std::atomic<unsigned> frames;
+    std::mutex display_mutex; // DisplayImage Ŵ
+
+    //  н OutputImage DisplayImage   ѱϴ. н ̿  尡 Ƿ
+    //    ڸ 带  ϴ.
+    void publish() {
+        std::lock_guard<std::mutex> lock(display_mutex);
+        OutputToneMapper.apply(OutputImage, DisplayImage);
+        ++frames;
+    }
+
+    void run() {
+        for (int block = COARSEST_BLOCK; block >= 1 && !cancelled; block /= 2) {
+            TileScheduler scheduler(Width, Height, TILE_SIZE, renderThreadCount());
+            scheduler.run([this, block](const Tile& tile) {
+                if (!cancelled) { // ҵǸ  Ÿ ǳʶ
+                    STAT_SCOPE("tile", tile.x0, tile.y0);
+                    renderTileBlocks(scene, tile, light_grid.tileLights(tile), block, block == COARSEST_BLOCK);
+                }
+            });
+            if (!cancelled) {
+                publish();
+            }
+        }
+        if (OutputAntiAliasing.enabled() && !cancelled) {
+            // ȼ   ϼ ȭ   ǥ    ٵ
+            std::atomic<long long> samples(0);
+            TileScheduler scheduler(Width, Height, TILE_SIZE, renderThreadCount());
+            scheduler.run([this, &samples](const Tile& tile) {
+                if (!cancelled) {
+                    STAT_SCOPE("tile", tile.x0, tile.y0);
+                    renderTileAdaptive(scene, tile, OutputAntiAliasing, light_grid.tileLights(tile), samples);
+                }
+            });
+            if (!cancelled) {
+                publish();
+            }
+        }
+        if (!OutputAntiAliasing.enabled() && !cancelled) {
+            finishPrimaryRecords(); //  н  ȼ   
+        }
+        running = false;
+    }
+};
+
+// -------------------------------------------------
+// ȭ  (â )
+
+enum class PresentFormat {
+    RGBA8, // ȼ 4Ʈ
+    Half   // ȼ 8Ʈ, 8Ʈ ȭ     ״  
+};
+
+PresentFormat OutputPresentFormat = PresentFormat::RGBA8;
+
+// Presenter Ŭ: ȭ ۸ RGBA8 Ǵ half float  PBO(pixel buffer object) 
+// ؽó Ʈϰ, â ü  簢 ϳ ׸ϴ.
+// ȼ 12Ʈ float   glDrawPixels  Ͱ ޸, ̹ ٲ ӿ εմϴ.
+class Presenter {
+public:
+    Presenter() : texture(0), pbo(0), tex_width(0), tex_height(0) {}
+
+    void init() {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        if (GLEW_ARB_pixel_buffer_object) {
+            glGenBuffersARB(1, &pbo);
+        }
+        if (OutputPresentFormat == PresentFormat::Half && !(GLEW_ARB_texture_float && GLEW_ARB_half_float_pixel)) {
+            OutputPresentFormat = PresentFormat::RGBA8; // half float ؽó  ʴ ̹
+        }
+    }
+
+    void release() {
+        if (pbo) {
+            glDeleteBuffersARB(1, &pbo);
+        }
+        glDeleteTextures(1, &texture);
+    }
+
+    // display  ؽó øϴ. PBO  ̹ ޸𸮿 ٷ , DMA 񵿱 ۵˴ϴ.
+    void upload(const Framebuffer& display) {
+        bool half = OutputPresentFormat == PresentFormat::Half;
+        size_t pixel_size = half ? 8 : 4;
+        size_t size = static_cast<size_t>(display.width) * display.height * pixel_size;
+        glBindTexture(GL_TEXTURE_2D, texture);
+        if (display.width != tex_width || display.height != tex_height) {
+            tex_width = display.width;
+            tex_height = display.height;
+            glTexImage2D(GL_TEXTURE_2D, 0, half ? GL_RGBA16F_ARB : GL_RGBA8, tex_width, tex_height, 0,
+                GL_RGBA, half ? GL_HALF_FLOAT_ARB : GL_UNSIGNED_BYTE, nullptr);
+        }
+        void* dst = nullptr;
+        if (pbo) {
+            glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, pbo);
+            glBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, size, nullptr, GL_STREAM_DRAW_ARB); //  ۸  GPU    
+            dst = glMapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+        }
+        if (!dst) {
+            staging.resize(size);
+            dst = &staging[0];
+        }
+        if (half) {
+            packHalf(display, static_cast<uint64*>(dst));
+        }
+        else {
+            packRGBA8(display, static_cast<uint32*>(dst));
+        }
+        const void* pixels = dst;
+        if (pbo) {
+            glUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB);
+            pixels = nullptr; // PBO εǾ  ʹ   
+        }
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, tex_width, tex_height, GL_RGBA, half ? GL_HALF_FLOAT_ARB : GL_UNSIGNED_BYTE, pixels);
+        if (pbo) {
+            glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+        }
+    }
+
+    // ؽó â ü ׸ϴ (resize_callback glOrtho ǥ ).
+    void draw() const {
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glBegin(GL_QUADS);
+        glTexCoord2f(0.0f, 0.0f); glVertex2f(0.0f, 0.0f);
+        glTexCoord2f(1.0f, 0.0f); glVertex2f(static_cast<float>(Width), 0.0f);
+        glTexCoord2f(1.0f, 1.0f); glVertex2f(static_cast<float>(Width), static_cast<float>(Height));
+        glTexCoord2f(0.0f, 1.0f); glVertex2f(0.0f, static_cast<float>(Height));
+        glEnd();
+        glDisable(GL_TEXTURE_2D);
+    }
+
+private:
+    GLuint texture;
+    GLuint pbo;
+    int tex_width, tex_height;
+    std::vector<unsigned char> staging; // PBO     ε 
+
+    static void packRGBA8(const Framebuffer& display, uint32* dst) {
+        for (int j = 0; j < display.height; ++j) {
+            const vec3* row = &display.at(0, j);
+            for (int i = 0; i < display.width; ++i) {
+                *dst++ = packUnorm4x8(vec4(row[i], 1.0f));
+            }
+        }
+    }
+
+    static void packHalf(const Framebuffer& display, uint64* dst) {
+        for (int j = 0; j < display.height; ++j) {
+            const vec3* row = &display.at(0, j);
+            for (int i = 0; i < display.width; ++i) {
+                *dst++ = packHalf4x16(vec4(row[i], 1.0f));
+            }
+        }
+    }
+};
+
+void resize_callback(GLFWwindow* window, int nw, int nh) {
+    // ũ⸦ ٲٱ     ϰ, ٲ   ũ ٽ մϴ.
+    ProgressiveRenderer* renderer = window ? static_cast<ProgressiveRenderer*>(glfwGetWindowUserPointer(window)) : nullptr;
+    if (renderer) {
+        renderer->cancel();
+    }
+    Width = nw;
+    Height = nh;
+    glViewport(0, 0, nw, nh);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(0.0, static_cast<double>(Width),
+        0.0, static_cast<double>(Height),
+        1.0, -1.0);
+    OutputImage.resize(Width, Height);
+    if (renderer) {
+        renderer->start();
+    }
+}
+
+// ù °  Ű  J/L (x), K/I (y), U/O (z) Դϴ.  ī޶ ״̹Ƿ G-buffer ٽ  óմϴ.
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (action == GLFW_RELEASE) {
+        return;
+    }
+    const float step = 0.5f;
+    vec3 offset(0.0f);
+    switch (key) {
+    case GLFW_KEY_J: offset.x = -step; break;
+    case GLFW_KEY_L: offset.x = step; break;
+    case GLFW_KEY_K: offset.y = -step; break;
+    case GLFW_KEY_I: offset.y = step; break;
+    case GLFW_KEY_U: offset.z = -step; break;
+    case GLFW_KEY_O: offset.z = step; break;
+    default: return;
+    }
+    ProgressiveRenderer* renderer = static_cast<ProgressiveRenderer*>(glfwGetWindowUserPointer(window));
+    Scene& scene = renderer->getScene();
+    if (scene.lights.empty()) {
+        return;
+    }
+    renderer->cancel(); // ۾ 尡  д  ٲ ʵ
+    scene.lights[0].position += offset;
+    renderer->relight();
+}
+
+// -------------------------------------------------
+//  
+//
+//  ٿ  ϳ  ؽƮ ̸ '#'   ּԴϴ.    ̸ մϴ.
+//   camera <eye xyz> <u xyz> <v xyz> <w xyz> <l> <r> <b> <t> <d>
+//   light <x> <y> <z> [color <r> <g> <b>] [range <r>] [spot <dx> <dy> <dz> <inner degrees> <outer degrees>]
+//                                (    , ù  ⺻  )
+//   material <name> <ka rgb> <kd rgb> <ks rgb> <specular_power>
+//   plane <y> <material>
+//   mesh <file.obj> <material>   (δ   )
+//   object <name> ... end        (   鿡  ׷ )
+//   instance <object> [translate <x> <y> <z>] [rotate <degrees> <ax> <ay> <az>] [scale <s> | scale <x> <y> <z>] ...
+//   sphere <cx> <cy> <cz> <radius> <material>
+
+// MappedFile Ŭ:  ü б  ޸𸮿 մϴ. б ۷  ʰ
+// ü ʿ  ÷ ֹǷ  MB ϵ ٷ   ֽϴ.
+class MappedFile {
+public:
+    const char* data;
+    size_t size;
+
+    MappedFile() : data(nullptr), size(0) {}
+    ~MappedFile() {
+        close();
+    }
+
+    bool open(const std::string& path) {
+        close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER file_size;
+        GetFileSizeEx(file, &file_size);
+        size = static_cast<size_t>(file_size.QuadPart);
+        if (size > 0) {
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping) {
+                data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                CloseHandle(mapping); // 䰡   
+            }
+        }
+        CloseHandle(file);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        fstat(fd, &info);
+        size = static_cast<size_t>(info.st_size);
+        if (size > 0) {
+            void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view != MAP_FAILED) {
+                madvise(view, size, MADV_SEQUENTIAL);
+                data = static_cast<const char*>(view);
+            }
+        }
+        ::close(fd);
+#endif
+        if (size > 0 && !data) {
+            size = 0;
+            return false;
+        }
+        if (size == 0) {
+            data = "";
+        }
+        return true;
+    }
+
+    void close() {
+        if (data && size > 0) {
+#ifdef _WIN32
+            UnmapViewOfFile(data);
+#else
+            munmap(const_cast<char*>(data), size);
+#endif
+        }
+        data = nullptr;
+        size = 0;
+    }
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+// Token ü: ε   ܾ ŵϴ (ڿ  ).
+struct Token {
+    const char* text;
+    size_t length;
+
+    bool is(const char* word) const {
+        return std::strlen(word) == length && std::memcmp(text, word, length) == 0;
+    }
+    std::string str() const {
+        return std::string(text, length);
+    }
+};
+
+// SceneParser Ŭ: ޸  ؽƮ տ    ܾ ڸ д ũ.
+// ū ޸𸮸 Ҵ ʰ, ڵ strtod   ȯմϴ.
+class SceneParser {
+public:
+    int line; //  ޽   ȣ
+
+    SceneParser(const char* begin, const char* end) : line(1), p(begin), end(end) {}
+
+    //  ܾ нϴ.  ̸ false.
+    bool next(Token& token) {
+        skipSpace();
+        if (p == end) {
+            return false;
+        }
+        token.text = p;
+        while (p != end && !isSpace(*p) && *p != '#') {
+            ++p;
+        }
+        token.length = static_cast<size_t>(p - token.text);
+        return true;
+    }
+
+    bool readFloat(float& value) {
+        skipSpace();
+        const char* start = p;
+        bool negative = false;
+        if (p != end && (*p == '-' || *p == '+')) {
+            negative = *p++ == '-';
+        }
+        unsigned long long mantissa = 0;
+        int exponent = 0;
+        int digits = 0;
+        for (; p != end && isDigit(*p); ++p, ++digits) {
+            if (mantissa < 1000000000000000000ull) {
+                mantissa = mantissa * 10 + (*p - '0');
+            }
+            else {
+                ++exponent; // 19ڸ Ѵ δ ڸ ݿ
+            }
+        }
+        if (p != end && *p == '.') {
+            for (++p; p != end && isDigit(*p); ++p, ++digits) {
+                if (mantissa < 1000000000000000000ull) {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    --exponent;
+                }
+            }
+        }
+        if (digits == 0) {
+            p = start;
+            return false;
+        }
+        if (p != end && (*p == 'e' || *p == 'E')) {
+            ++p;
+            bool negative_exp = false;
+            if (p != end && (*p == '-' || *p == '+')) {
+                negative_exp = *p++ == '-';
+            }
+            int e = 0;
+            for (; p != end && isDigit(*p); ++p) {
+                e = std::min(e * 10 + (*p - '0'), 1000);
+            }
+            exponent += negative_exp ? -e : e;
+        }
+        if (p != end && !isSpace(*p) && *p != '#') {
+            p = start; // "1.5abc"  ܾ ڰ ƴ
+            return false;
+        }
+        static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+        double result = static_cast<double>(mantissa);
+        if (exponent < 0) {
+            result = exponent >= -22 ? result / powers[-exponent] : result * std::pow(10.0, exponent);
+        }
+        else if (exponent > 0) {
+            result = exponent <= 22 ? result * powers[exponent] : result * std::pow(10.0, exponent);
+        }
+        value = static_cast<float>(negative ? -result : result);
+        return true;
+    }
+
+    bool readVec3(vec3& value) {
+        return readFloat(value.x) && readFloat(value.y) && readFloat(value.z);
+    }
+
+    //   (OBJ):  ٿ   ܾ  true.
+    bool endOfLine() {
+        while (p != end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+            ++p;
+        }
+        if (p != end && *p == '#') {
+            while (p != end && *p != '\n') {
+                ++p;
+            }
+        }
+        return p == end || *p == '\n';
+    }
+
+    //    ǳʶݴϴ.
+    void skipLine() {
+        while (p != end && *p != '\n') {
+            ++p;
+        }
+    }
+
+private:
+    const char* p;
+    const char* end;
+
+    static bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+    static bool isDigit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    void skipSpace() {
+        while (p != end) {
+            if (*p == '\n') {
+                ++line;
+                ++p;
+            }
+            else if (isSpace(*p)) {
+                ++p;
+            }
+            else if (*p == '#') {
+                while (p != end && *p != '\n') {
+                    ++p;
+                }
+            }
+            else {
+                break;
+            }
+        }
+    }
+};
+
+// OBJ   ϳ("v", "v/vt", "v//vn", "v/vt/vn") нϴ. ȣ 1̰   ϴ.
+//  ׸ 0 ϴ.
+bool parseOBJVertex(const Token& token, int index[3]) {
+    const char* p = token.text;
+    const char* end = token.text + token.length;
+    for (int k = 0; k < 3; ++k) {
+        index[k] = 0;
+        bool negative = p != end && *p == '-';
+        if (negative) {
+            ++p;
+        }
+        bool digits = false;
+        for (; p != end && *p >= '0' && *p <= '9'; ++p) {
+            index[k] = index[k] * 10 + (*p - '0');
+            digits = true;
+        }
+        if (negative) {
+            index[k] = -index[k];
+        }
+        if ((negative && !digits) || (k == 0 && !digits)) {
+            return false;
+        }
+        if (p == end) {
+            return true;
+        }
+        if (*p++ != '/') {
+            return false;
+        }
+    }
+    return p == end;
+}
+
+// OBJ  v, vn, f  ﰢ ޽ø ϴ (ٰ  ä÷ ).   մϴ.
+// ϸ  ϰ nullptr ȯմϴ.
+TriangleMesh* loadOBJ(const std::string& path, int material_id) {
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cerr << "Cannot open mesh file " << path << std::endl;
+        return nullptr;
+    }
+    SceneParser parser(file.data, file.data + file.size);
+    TriangleMesh* mesh = new TriangleMesh(material_id);
+    auto fail = [&](const std::string& message) -> TriangleMesh* {
+        std::cerr << path << ":" << parser.line << ": " << message << std::endl;
+        delete mesh;
+        return nullptr;
+    };
+    //   ȣ 0 ϴ 迭 ȣ ٲ
+    auto resolve = [](int index, size_t count) {
+        return index > 0 ? index - 1 : static_cast<int>(count) + index;
+    };
+
+    std::vector<int> face_positions, face_normals; //  ϳ  ()
+    Token word;
+    while (parser.next(word)) {
+        if (word.is("v")) {
+            vec3 position;
+            if (!parser.readVec3(position)) {
+                return fail("expected: v <x> <y> <z>");
+            }
+            mesh->positions.push_back(position);
+        }
+        else if (word.is("vn")) {
+            vec3 normal;
+            if (!parser.readVec3(normal)) {
+                return fail("expected: vn <x> <y> <z>");
+            }
+            mesh->normals.push_back(normal);
+        }
+        else if (word.is("f")) {
+            face_positions.clear();
+            face_normals.clear();
+            while (!parser.endOfLine()) {
+                Token vertex;
+                int index[3];
+                parser.next(vertex);
+                if (!parseOBJVertex(vertex, index)) {
+                    return fail("bad face vertex '" + vertex.str() + "'");
+                }
+                int position = resolve(index[0], mesh->positions.size());
+                int normal = index[2] != 0 ? resolve(index[2], mesh->normals.size()) : -1;
+                if (position < 0 || position >= static_cast<int>(mesh->positions.size())
+                    || (index[2] != 0 && (normal < 0 || normal >= static_cast<int>(mesh->normals.size())))) {
+                    return fail("face vertex '" + vertex.str() + "' is out of range");
+                }
+                face_positions.push_back(position);
+                face_normals.push_back(normal);
+            }
+            if (face_positions.size() < 3) {
+                return fail("a face needs at least 3 vertices");
+            }
+            for (size_t k = 1; k + 1 < face_positions.size(); ++k) {
+                const size_t corners[3] = { 0, k, k + 1 };
+                for (size_t corner : corners) {
+                    mesh->position_index.push_back(face_positions[corner]);
+                    mesh->normal_index.push_back(face_normals[corner]);
+                }
+            }
+        }
+        else {
+            parser.skipLine(); // vt, o, g, s, usemtl, mtllib 
+        }
+    }
+    if (mesh->size() == 0) {
+        return fail("no faces");
+    }
+    //    ϳ  ޽ ü   
+    if (std::find(mesh->normal_index.begin(), mesh->normal_index.end(), -1) != mesh->normal_index.end()) {
+        mesh->normals.clear();
+        mesh->normal_index.clear();
+    }
+    mesh->build();
+    return mesh;
+}
+
+// ؽƮ   о scene ߰մϴ. camera light  scene ī޶  ϴ.
+//   ":: " ϰ false ȯմϴ.
+bool loadSceneText(const std::string& path, const MappedFile& file, Scene& scene) {
+    SceneParser parser(file.data, file.data + file.size);
+    std::vector<Token> material_names; //  ̸ ε  ״ Ŵ
+    std::vector<int> material_ids;
+    int last_material = -1; //     ޾  찡     
+    Scene* target = &scene; // object  ȿ  鿡 ߰
+    std::vector<std::pair<std::string, Scene*>> prototypes; // ̸  ( scene )
+    bool default_lights = true; // ù light     
+
+    auto fail = [&](const std::string& message) {
+        std::cerr << path << ":" << parser.line << ": " << message << std::endl;
+        return false;
+    };
+    auto readMaterial = [&](int& id) {
+        Token name;
+        if (!parser.next(name)) {
+            return fail("expected a material name");
+        }
+        if (last_material >= 0 && material_names[last_material].length == name.length
+            && std::memcmp(material_names[last_material].text, name.text, name.length) == 0) {
+            id = material_ids[last_material];
+            return true;
+        }
+        for (size_t k = 0; k < material_names.size(); ++k) {
+            if (material_names[k].length == name.length && std::memcmp(material_names[k].text, name.text, name.length) == 0) {
+                last_material = static_cast<int>(k);
+                id = material_ids[k];
+                return true;
+            }
+        }
+        return fail("unknown material '" + name.str() + "'");
+    };
+
+    Token word;
+    while (parser.next(word)) {
+        if (word.is("sphere")) {
+            vec3 center;
+            float radius;
+            int material;
+            if (!parser.readVec3(center) || !parser.readFloat(radius)) {
+                return fail("expected: sphere <cx> <cy> <cz> <radius> <material>");
+            }
+            if (!readMaterial(material)) {
+                return false;
+            }
+            target->addSphere(center, radius, material);
+        }
+        else if (word.is("mesh")) {
+            Token file_name;
+            int material;
+            if (!parser.next(file_name)) {
+                return fail("expected: mesh <file.obj> <material>");
+            }
+            if (!readMaterial(material)) {
+                return false;
+            }
+            std::string mesh_path = file_name.str();
+            size_t slash = path.find_last_of("/\\");
+            if (slash != std::string::npos && mesh_path.find_first_of("/\\") != 0 && mesh_path.find(':') == std::string::npos) {
+                mesh_path = path.substr(0, slash + 1) + mesh_path; //     
+            }
+            TriangleMesh* mesh = loadOBJ(mesh_path, material);
+            if (!mesh) {
+                return false;
+            }
+            target->addObject(mesh);
+        }
+        else if (word.is("plane")) {
+            float y;
+            int material;
+            if (!parser.readFloat(y)) {
+                return fail("expected: plane <y> <material>");
+            }
+            if (!readMaterial(material)) {
+                return false;
+            }
+            target->addObject(new Plane(y, material));
+        }
+        else if (word.is("material")) {
+            Token name;
+            vec3 ka, kd, ks;
+            float specular_power;
+            if (!parser.next(name) || !parser.readVec3(ka) || !parser.readVec3(kd) || !parser.readVec3(ks) || !parser.readFloat(specular_power)) {
+                return fail("expected: material <name> <ka rgb> <kd rgb> <ks rgb> <specular_power>");
+            }
+            material_names.push_back(name);
+            material_ids.push_back(scene.addMaterial(Material(ka, kd, ks, specular_power)));
+        }
+        else if (word.is("object")) {
+            Token name;
+            if (!parser.next(name)) {
+                return fail("expected: object <name>");
+            }
+            if (target != &scene) {
+                return fail("objects cannot be nested");
+            }
+            target = &scene.addPrototype();
+            prototypes.push_back(std::make_pair(name.str(), target));
+        }
+        else if (word.is("end")) {
+            if (target == &scene) {
+                return fail("'end' without 'object'");
+            }
+            AABB bounds;
+            target->buildAccel();
+            if (target->getBounds(bounds) && bounds.lo.x > bounds.hi.x) {
+                return fail("object '" + prototypes.back().first + "' is empty");
+            }
+            target = &scene;
+        }
+        else if (word.is("instance")) {
+            Token name;
+            if (!parser.next(name)) {
+                return fail("expected: instance <object> [translate x y z] [rotate degrees ax ay az] [scale s | scale x y z]...");
+            }
+            if (target != &scene) {
+                return fail("instances cannot be placed inside an object");
+            }
+            Scene* prototype = nullptr;
+            for (const auto& entry : prototypes) {
+                if (entry.first.size() == name.length && std::memcmp(entry.first.data(), name.text, name.length) == 0) {
+                    prototype = entry.second;
+                }
+            }
+            if (!prototype || prototype == target) {
+                return fail("unknown object '" + name.str() + "'");
+            }
+            // ȯ   ʿ  ( ȯ ü   )
+            mat4 transform(1.0f);
+            while (!parser.endOfLine()) {
+                Token op;
+                parser.next(op);
+                vec3 v;
+                float angle;
+                if (op.is("translate") && parser.readVec3(v)) {
+                    transform = translate(transform, v);
+                }
+                else if (op.is("rotate") && parser.readFloat(angle) && parser.readVec3(v)) {
+                    transform = rotate(transform, radians(angle), v);
+                }
+                else if (op.is("scale") && parser.readFloat(v.x)) {
+                    v.y = v.z = v.x;
+                    if (!parser.endOfLine() && parser.readFloat(v.y)) {
+                        if (!parser.readFloat(v.z)) {
+                            return fail("expected: scale <s> or scale <x> <y> <z>");
+                        }
+                    }
+                    transform = scale(transform, v);
+                }
+                else {
+                    return fail("bad instance transform '" + op.str() + "'");
+                }
+            }
+            scene.addObject(new Instance(*prototype, transform));
+        }
+        else if (word.is("light")) {
+            if (target != &scene) {
+                return fail("lights cannot be placed inside an object");
+            }
+            Light light(vec3(0.0f));
+            if (!parser.readVec3(light.position)) {
+                return fail("expected: light <x> <y> <z> [color <r> <g> <b>] [range <r>] [spot <dx> <dy> <dz> <inner degrees> <outer degrees>]");
+            }
+            while (!parser.endOfLine()) {
+                Token option;
+                parser.next(option);
+                float inner, outer;
+                if (option.is("color")) {
+                    if (!parser.readVec3(light.color)) {
+                        return fail("expected: color <r> <g> <b>");
+                    }
+                }
+                else if (option.is("range")) {
+                    if (!parser.readFloat(light.range) || light.range < 0.0f) {
+                        return fail("expected: range <r> with r >= 0 (0 = unlimited)");
+                    }
+                }
+                else if (option.is("spot")) {
+                    if (!parser.readVec3(light.direction) || !parser.readFloat(inner) || !parser.readFloat(outer)
+                        || !(0.0f <= inner && inner < outer && outer < 180.0f) || length(light.direction) == 0.0f) {
+                        return fail("expected: spot <dx> <dy> <dz> <inner degrees> <outer degrees> with 0 <= inner < outer < 180");
+                    }
+                    light.direction = normalize(light.direction);
+                    light.cos_inner = std::cos(radians(inner));
+                    light.cos_outer = std::cos(radians(outer));
+                }
+                else {
+                    return fail("bad light option '" + option.str() + "'");
+                }
+            }
+            if (default_lights) {
+                scene.lights.clear();
+                default_lights = false;
+            }
+            scene.lights.push_back(light);
+        }
+        else if (word.is("camera")) {
+            if (target != &scene) {
+                return fail("cameras cannot be placed inside an object");
+            }
+            Camera& c = scene.camera;
+            if (!parser.readVec3(c.eye) || !parser.readVec3(c.u) || !parser.readVec3(c.v) || !parser.readVec3(c.w)
+                || !parser.readFloat(c.l) || !parser.readFloat(c.r) || !parser.readFloat(c.b) || !parser.readFloat(c.t) || !parser.readFloat(c.d)) {
+                return fail("expected: camera <eye xyz> <u xyz> <v xyz> <w xyz> <l> <r> <b> <t> <d>");
+            }
+        }
+        else {
+            return fail("unknown statement '" + word.str() + "'");
+        }
+    }
+    if (target != &scene) {
+        return fail("missing 'end' for object '" + prototypes.back().first + "'");
+    }
+    return true;
+}
+
+// -------------------------------------------------
+//  
+//
+// , , ,  SoA 迭 ̸   BVH ޸  ״   Դϴ.  ġ
+//    ̶  ּҿ εǾ   ְ, ū 迭 Array::view  
+// ŰǷ   Ľ̳ BVH   ٷ  մϴ ( ó   ö).
+// 迭  ü(BVHNode )  ٲ SNAPSHOT_VERSION ÷   źմϴ.
+
+const char SNAPSHOT_MAGIC[8] = { 'E', 'V', 'S', 'C', 'E', 'N', 'E', '\0' };
+const uint32_t SNAPSHOT_VERSION = 2; // 2:  
+const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304; // ٸ  迡  ̸ ٸ 
+const uint64_t SNAPSHOT_ALIGNMENT = 64; // 迭  ĳ ٿ 
+
+enum SnapshotArrayKind {
+    SNAPSHOT_MATERIALS,      //  ka, kd, ks, specular_power (float 10)
+    SNAPSHOT_PLANES,         // SnapshotPlane
+    SNAPSHOT_SPHERE_X,       // SphereSet::cx
+    SNAPSHOT_SPHERE_Y,       // SphereSet::cy
+    SNAPSHOT_SPHERE_Z,       // SphereSet::cz
+    SNAPSHOT_SPHERE_RADIUS,  // SphereSet::radius
+    SNAPSHOT_SPHERE_MATERIAL, // SphereSet::material_id
+    SNAPSHOT_SPHERE_NODES,   // SphereSet::bvh.nodes
+    SNAPSHOT_LIGHTS,         //  position, color, range, direction, cos_inner, cos_outer (float 12)
+    SNAPSHOT_ARRAY_COUNT
+};
+
+struct SnapshotPlane {
+    float y;
+    int32_t material_id;
+};
+
+struct SnapshotArray {
+    uint64_t offset; //   
+    uint64_t count;
+    uint32_t element_size;
+    uint32_t reserved;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    float camera[17]; // eye, u, v, w, l, r, b, t, d
+    uint32_t reserved[3];
+    SnapshotArray arrays[SNAPSHOT_ARRAY_COUNT];
+};
+
+static_assert(sizeof(SnapshotHeader) == 96 + sizeof(SnapshotArray) * SNAPSHOT_ARRAY_COUNT, "snapshot header must not contain padding");
+static_assert(sizeof(BVHNode) == 32, "changing BVHNode requires a new SNAPSHOT_VERSION");
+
+// 迭   ũ: Ͽ   ٸ ٸ 忡  Ϸ  źմϴ.
+const uint32_t SNAPSHOT_ELEMENT_SIZE[SNAPSHOT_ARRAY_COUNT] = {
+    sizeof(float) * 10, sizeof(SnapshotPlane), sizeof(float), sizeof(float), sizeof(float), sizeof(float), sizeof(int), sizeof(BVHNode),
+    sizeof(float) * 12
+};
+
+//       Ϸ մϴ.   Ҹ   ֽϴ.
+bool writeSceneSnapshot(const std::string& path, Scene& scene) {
+    scene.buildAccel();
+
+    std::vector<float> materials;
+    for (const Material& material : scene.materials) {
+        const float values[10] = { material.ka.x, material.ka.y, material.ka.z, material.kd.x, material.kd.y, material.kd.z,
+            material.ks.x, material.ks.y, material.ks.z, material.specular_power };
+        materials.insert(materials.end(), values, values + 10);
+    }
+    std::vector<float> lights;
+    for (const Light& light : scene.lights) {
+        const float values[12] = { light.position.x, light.position.y, light.position.z, light.color.x, light.color.y, light.color.z,
+            light.range, light.direction.x, light.direction.y, light.direction.z, light.cos_inner, light.cos_outer };
+        lights.insert(lights.end(), values, values + 12);
+    }
+    std::vector<SnapshotPlane> planes;
+    for (const Surface* object : scene.objects) {
+        const Plane* plane = dynamic_cast<const Plane*>(object);
+        if (!plane) {
+            std::cerr << "Scene snapshots can only hold planes and spheres" << std::endl;
+            return false;
+        }
+        SnapshotPlane record = { plane->y, plane->material_id };
+        planes.push_back(record);
+    }
+
+    const SphereSet& spheres = scene.spheres;
+    const void* data[SNAPSHOT_ARRAY_COUNT] = {
+        materials.data(), planes.data(), spheres.cx.data(), spheres.cy.data(), spheres.cz.data(),
+        spheres.radius.data(), spheres.material_id.data(), spheres.bvh.nodes.data(), lights.data()
+    };
+    const uint64_t counts[SNAPSHOT_ARRAY_COUNT] = {
+        scene.materials.size(), planes.size(), spheres.cx.size(), spheres.cy.size(), spheres.cz.size(),
+        spheres.radius.size(), spheres.material_id.size(), spheres.bvh.nodes.size(), scene.lights.size()
+    };
+
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    const Camera& c = scene.camera;
+    const float camera[17] = { c.eye.x, c.eye.y, c.eye.z, c.u.x, c.u.y, c.u.z, c.v.x, c.v.y, c.v.z, c.w.x, c.w.y, c.w.z, c.l, c.r, c.b, c.t, c.d };
+    std::memcpy(header.camera, camera, sizeof(camera));
+    uint64_t offset = sizeof(SnapshotHeader);
+    for (int k = 0; k < SNAPSHOT_ARRAY_COUNT; ++k) {
+        offset = (offset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+        header.arrays[k].offset = offset;
+        header.arrays[k].count = counts[k];
+        header.arrays[k].element_size = SNAPSHOT_ELEMENT_SIZE[k];
+        offset += counts[k] * SNAPSHOT_ELEMENT_SIZE[k];
+    }
+
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file) {
+        std::cerr << "Cannot open " << path << " for writing" << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    const char padding[SNAPSHOT_ALIGNMENT] = {};
+    uint64_t written = sizeof(header);
+    for (int k = 0; k < SNAPSHOT_ARRAY_COUNT; ++k) {
+        file.write(padding, static_cast<std::streamsize>(header.arrays[k].offset - written));
+        file.write(static_cast<const char*>(data[k]), static_cast<std::streamsize>(counts[k] * SNAPSHOT_ELEMENT_SIZE[k]));
+        written = header.arrays[k].offset + counts[k] * SNAPSHOT_ELEMENT_SIZE[k];
+    }
+    if (!file) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// ε    äϴ.  迭 BVH   ŰǷ file scene 
+//  ־ մϴ.  迭  ˻ϰ, 迭  --save-snapshot   Ͻϴ.
+bool loadSceneSnapshot(const std::string& path, const MappedFile& file, Scene& scene) {
+    auto fail = [&](const std::string& message) {
+        std::cerr << path << ": " << message << std::endl;
+        return false;
+    };
+    SnapshotHeader header;
+    if (file.size < sizeof(header)) {
+        return fail("truncated scene snapshot");
+    }
+    std::memcpy(&header, file.data, sizeof(header));
+    if (header.byte_order != SNAPSHOT_BYTE_ORDER) {
+        return fail("scene snapshot was written on a machine with a different byte order");
+    }
+    if (header.version != SNAPSHOT_VERSION) {
+        return fail("scene snapshot version " + std::to_string(header.version) + " is not supported (expected "
+            + std::to_string(SNAPSHOT_VERSION) + "); re-create it with --save-snapshot");
+    }
+    for (int k = 0; k < SNAPSHOT_ARRAY_COUNT; ++k) {
+        const SnapshotArray& array = header.arrays[k];
+        if (array.element_size != SNAPSHOT_ELEMENT_SIZE[k]) {
+            return fail("scene snapshot was written by an incompatible build; re-create it with --save-snapshot");
+        }
+        if (array.offset % SNAPSHOT_ALIGNMENT != 0 || array.offset > file.size
+            || array.count > (file.size - array.offset) / array.element_size) {
+            return fail("corrupt scene snapshot");
+        }
+    }
+    const SnapshotArray* arrays = header.arrays;
+    uint64_t sphere_count = arrays[SNAPSHOT_SPHERE_X].count;
+    if (arrays[SNAPSHOT_SPHERE_Y].count != sphere_count || arrays[SNAPSHOT_SPHERE_Z].count != sphere_count
+        || arrays[SNAPSHOT_SPHERE_RADIUS].count != sphere_count || arrays[SNAPSHOT_SPHERE_MATERIAL].count != sphere_count) {
+        return fail("corrupt scene snapshot");
+    }
+    if (!scene.materials.empty() || !scene.objects.empty() || scene.spheres.size() > 0) {
+        return fail("a scene snapshot can only be loaded into an empty scene");
+    }
+
+    const float* camera = header.camera;
+    scene.camera = Camera(vec3(camera[0], camera[1], camera[2]), vec3(camera[3], camera[4], camera[5]),
+        vec3(camera[6], camera[7], camera[8]), vec3(camera[9], camera[10], camera[11]),
+        camera[12], camera[13], camera[14], camera[15], camera[16]);
+
+    // , ,     ʾ ϰ, ū 迭  ŵϴ.
+    const float* materials = reinterpret_cast<const float*>(file.data + arrays[SNAPSHOT_MATERIALS].offset);
+    for (uint64_t k = 0; k < arrays[SNAPSHOT_MATERIALS].count; ++k, materials += 10) {
+        scene.addMaterial(Material(vec3(materials[0], materials[1], materials[2]), vec3(materials[3], materials[4], materials[5]),
+            vec3(materials[6], materials[7], materials[8]), materials[9]));
+    }
+    const float* lights = reinterpret_cast<const float*>(file.data + arrays[SNAPSHOT_LIGHTS].offset);
+    scene.lights.clear();
+    for (uint64_t k = 0; k < arrays[SNAPSHOT_LIGHTS].count; ++k, lights += 12) {
+        Light light(vec3(lights[0], lights[1], lights[2]));
+        light.color = vec3(lights[3], lights[4], lights[5]);
+        light.range = lights[6];
+        light.direction = vec3(lights[7], lights[8], lights[9]);
+        light.cos_inner = lights[10];
+        light.cos_outer = lights[11];
+        scene.lights.push_back(light);
+    }
+    const SnapshotPlane* planes = reinterpret_cast<const SnapshotPlane*>(file.data + arrays[SNAPSHOT_PLANES].offset);
+    for (uint64_t k = 0; k < arrays[SNAPSHOT_PLANES].count; ++k) {
+        scene.addObject(new Plane(planes[k].y, planes[k].material_id));
+    }
+
+    SphereSet& spheres = scene.spheres;
+    spheres.cx.view(reinterpret_cast<const float*>(file.data + arrays[SNAPSHOT_SPHERE_X].offset), sphere_count);
+    spheres.cy.view(reinterpret_cast<const float*>(file.data + arrays[SNAPSHOT_SPHERE_Y].offset), sphere_count);
+    spheres.cz.view(reinterpret_cast<const float*>(file.data + arrays[SNAPSHOT_SPHERE_Z].offset), sphere_count);
+    spheres.radius.view(reinterpret_cast<const float*>(file.data + arrays[SNAPSHOT_SPHERE_RADIUS].offset), sphere_count);
+    spheres.material_id.view(reinterpret_cast<const int*>(file.data + arrays[SNAPSHOT_SPHERE_MATERIAL].offset), sphere_count);
+    spheres.bvh.nodes.view(reinterpret_cast<const BVHNode*>(file.data + arrays[SNAPSHOT_SPHERE_NODES].offset),
+        arrays[SNAPSHOT_SPHERE_NODES].count);
+    spheres.bvh.prim_ids.clear(); // build() 迭   ġǷ ȸ ʿ 
+    spheres.dirty = false;
+    return true;
+}
+
+//    нϴ. ̸ scene file Ű ǹǷ file scene   ־ մϴ.
+bool loadSceneFile(const std::string& path, Scene& scene, MappedFile& file) {
+    if (!file.open(path)) {
+        std::cerr << "Cannot open scene file " << path << std::endl;
+        return false;
+    }
+    if (file.size >= sizeof(SNAPSHOT_MAGIC) && std::memcmp(file.data, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0) {
+        return loadSceneSnapshot(path, file, scene);
+    }
+    bool loaded = loadSceneText(path, file, scene);
+    file.close(); // ؽƮ     ʿ 
+    return loaded;
+}
+
+// -------------------------------------------------
+// ̹   (帮 )
+
+// ȭ  8Ʈ ȭմϴ.
+unsigned char toByte(float value) {
+    return static_cast<unsigned char>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+// DisplayImage   8Ʈ RGB ϴ (̹ glDrawPixels Ծ Ʒ  ).
+std::vector<unsigned char> packRGB8() {
+    std::vector<unsigned char> rgb(static_cast<size_t>(Width) * Height * 3);
+    size_t n = 0;
+    for (int j = Height - 1; j >= 0; --j) {
+        for (int i = 0; i < Width; ++i) {
+            const vec3& color = DisplayImage.at(i, j);
+            rgb[n++] = toByte(color.r);
+            rgb[n++] = toByte(color.g);
+            rgb[n++] = toByte(color.b);
+        }
+    }
+    return rgb;
+}
+
+bool writePPM(const std::string& path) {
+    std::ofstream file(path.c_str(), std::ios::binary);
+    std::vector<unsigned char> rgb = packRGB8();
+    file << "P6\n" << Width << " " << Height << "\n255\n";
+    file.write(reinterpret_cast<const char*>(&rgb[0]), rgb.size());
+    return file.good();
+}
+
+// PFM     OutputImage ϴ. Ʒ  ϴ ̶   ϴ (  = Ʋ ).
+bool writePFM(const std::string& path) {
+    std::ofstream file(path.c_str(), std::ios::binary);
+    file << "PF\n" << Width << " " << Height << "\n-1.0\n";
+    for (int j = 0; j < Height; ++j) {
+        file.write(reinterpret_cast<const char*>(&OutputImage.at(0, j)), Width * sizeof(vec3));
+    }
+    return file.good();
+}
+
+unsigned int crc32(const unsigned char* data, size_t size, unsigned int crc = 0) {
+    static unsigned int table[256];
+    static bool table_ready = false;
+    if (!table_ready) {
+        for (unsigned int n = 0; n < 256; ++n) {
+            unsigned int c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        table_ready = true;
+    }
+    crc = ~crc;
+    for (size_t k = 0; k < size; ++k) {
+        crc = table[(crc ^ data[k]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void appendBE32(std::vector<unsigned char>& out, unsigned int value) {
+    out.push_back(static_cast<unsigned char>(value >> 24));
+    out.push_back(static_cast<unsigned char>(value >> 16));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+void writePNGChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data) {
+    std::vector<unsigned char> chunk;
+    appendBE32(chunk, static_cast<unsigned int>(data.size()));
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    appendBE32(chunk, crc32(&chunk[4], chunk.size() - 4));
+    file.write(reinterpret_cast<const char*>(&chunk[0]), chunk.size());
+}
+
+// zlib ̺귯      deflate (stored block) PNG ϴ.
+bool writePNG(const std::string& path) {
+    std::vector<unsigned char> rgb = packRGB8();
+    size_t row_size = static_cast<size_t>(Width) * 3;
+    std::vector<unsigned char> raw; // ึ  Ʈ(0 = None) + RGB
+    raw.reserve((row_size + 1) * Height);
+    for (int j = 0; j < Height; ++j) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb.begin() + j * row_size, rgb.begin() + (j + 1) * row_size);
+    }
+
+    std::vector<unsigned char> idat;
+    idat.push_back(0x78); // zlib : deflate, 32K â
+    idat.push_back(0x01);
+    const size_t max_block = 65535;
+    for (size_t pos = 0; pos < raw.size() || pos == 0; pos += max_block) {
+        size_t len = std::min(max_block, raw.size() - pos);
+        idat.push_back(pos + len == raw.size() ? 1 : 0); //   ǥ
+        idat.push_back(static_cast<unsigned char>(len));
+        idat.push_back(static_cast<unsigned char>(len >> 8));
+        idat.push_back(static_cast<unsigned char>(~len));
+        idat.push_back(static_cast<unsigned char>(~len >> 8));
+        idat.insert(idat.end(), raw.begin() + pos, raw.begin() + pos + len);
+    }
+    unsigned int s1 = 1, s2 = 0; // Adler-32
+    for (unsigned char byte : raw) {
+        s1 = (s1 + byte) % 65521;
+        s2 = (s2 + s1) % 65521;
+    }
+    appendBE32(idat, (s2 << 16) | s1);
+
+    std::vector<unsigned char> header;
+    appendBE32(header, Width);
+    appendBE32(header, Height);
+    header.push_back(8); // äδ 8Ʈ
+    header.push_back(2); // RGB
+    header.push_back(0); // deflate
+    header.push_back(0); //  
+    header.push_back(0); //  ֻ 
+
+    std::ofstream file(path.c_str(), std::ios::binary);
+    const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    file.write(reinterpret_cast<const char*>(signature), 8);
+    writePNGChunk(file, "IHDR", header);
+    writePNGChunk(file, "IDAT", idat);
+    writePNGChunk(file, "IEND", std::vector<unsigned char>());
+    return file.good();
+}
+
+// Ȯ(.ppm, .pfm, .png) ´    մϴ.
+bool writeImage(const std::string& path) {
+    STAT_SCOPE("write");
+    std::string ext = path.size() >= 4 ? path.substr(path.size() - 4) : "";
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if (ext == ".ppm") {
+        return writePPM(path);
+    }
+    if (ext == ".pfm") {
+        return writePFM(path);
+    }
+    if (ext == ".png") {
+        return writePNG(path);
+    }
+    std::cerr << "Unknown image format: " << path << " (use .ppm, .pfm or .png)" << std::endl;
+    return false;
+}
+
+// 0..1  , , Ȳ,  ̾ infernoǳ   ŵϴ.   ȼԴϴ.
+vec3 heatmapColor(float value) {
+    static const vec3 stops[] = {
+        vec3(0.0f, 0.0f, 0.02f), vec3(0.26f, 0.04f, 0.41f), vec3(0.73f, 0.21f, 0.33f),
+        vec3(0.98f, 0.55f, 0.04f), vec3(0.99f, 1.0f, 0.64f)
+    };
+    float x = std::min(std::max(value, 0.0f), 1.0f) * 4.0f;
+    int k = std::min(static_cast<int>(x), 3);
+    return mix(stops[k], stops[k + 1], x - k);
+}
+
+// PixelCost Ʈ  path ϴ. PNG/PPM    DisplayImage, PFM   ü
+// ȸ ϴ. ѵ ȼ Ƣ  ü Ӱ  ʵ 99°     ,
+//   scale ݴϴ.   ۸ Ƿ beauty ̹  ڿ ȣմϴ.
+bool writeHeatmap(const std::string& path, float& scale) {
+    std::vector<float> sorted(PixelCost);
+    size_t rank = sorted.size() * 99 / 100;
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    scale = std::max(sorted[rank], 1e-6f);
+    DisplayImage.resize(Width, Height);
+    for (int j = 0; j < Height; ++j) {
+        for (int i = 0; i < Width; ++i) {
+            float cost = PixelCost[static_cast<size_t>(j) * Width + i];
+            OutputImage.at(i, j) = vec3(cost);
+            DisplayImage.at(i, j) = heatmapColor(cost / scale);
+        }
+    }
+    return writeImage(path);
+}
+
+// -------------------------------------------------
+// ġũ
+//
+// --bench ⺻  ũκġũ,    ػ󵵿   ٲ  render()
+// ׸ ܰ ġũ  CSV Ǵ JSON մϴ.   õ  ึ ,
+//     ݺ   ð ϴ. Ŷ , Ƽϸ  ٸ ɼ ״ ˴ϴ.
+
+// BenchResult ü:  ϳ 
+struct BenchResult {
+    std::string benchmark; // micro, build, render, reshade Ǵ edit
+    std::string name;      //   (Լ ̸ Ǵ  ̸)
+    long long objects;     //   
+    int width, height, threads;
+    long long rays;        //    ó 1   (ũκġũ ȣ , ׸   )
+    double seconds;        //    ð
+    double efficiency;     // 1   ȿ: t1 / (threads * t)
+};
+
+// BenchRandom Ŭ: ÷ ϰ    splitmix64  
+class BenchRandom {
+public:
+    explicit BenchRandom(uint64_t seed) : state(seed) {}
+
+    float next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        z ^= z >> 31;
+        return static_cast<float>(z >> 40) * (1.0f / 16777216.0f);
+    }
+
+    float range(float lo, float hi) {
+        return lo + (hi - lo) * next();
+    }
+
+private:
+    uint64_t state;
+};
+
+// work ּ  , հ 0.5 Ǵ 5   ݺϰ   ð() ȯմϴ.
+template <class Work>
+double benchBest(Work work) {
+    double best = INFINITY;
+    double total = 0.0;
+    for (int run = 0; run < 5 && total < 0.5; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        work();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, seconds);
+        total += seconds;
+    }
+    return best;
+}
+
+// ġũ  ϴ. ī޶ ⺻    ʿ Ӵϴ.
+//   field:   ȭ   ȿ    count ٴ 
+//   cluster:   ȿ ϰ    count ( BVH, ȭ κ  )
+//   sky:      Ʒ ִ  count (ȭ   ƹ͵  )
+//   lights:  ٴ   200     count  (⺻  )
+void buildBenchScene(const std::string& kind, int count, Scene& scene) {
+    BenchRandom random(static_cast<uint64_t>(count) * 7919u + kind.size());
+    int diffuse = scene.addMaterial(Material(vec3(0.1f), vec3(0.6f, 0.6f, 0.6f), vec3(0.0f), 0.0f));
+    int glossy = scene.addMaterial(Material(vec3(0.1f, 0.0f, 0.0f), vec3(0.8f, 0.2f, 0.2f), vec3(0.5f), 32.0f));
+    if (kind == "field") {
+        const float volume = 40.0f * 30.0f * 55.0f;
+        float radius = std::min(2.0f, 0.4f * std::cbrt(volume / count));
+        scene.addObject(new Plane(-10.0f, diffuse));
+        for (int k = 0; k < count; ++k) {
+            vec3 center(random.range(-20.0f, 20.0f), random.range(-10.0f, 20.0f), random.range(-60.0f, -5.0f));
+            scene.addSphere(center, radius * random.range(0.5f, 1.0f), k % 2 ? glossy : diffuse);
+        }
+    }
+    else if (kind == "cluster") {
+        for (int k = 0; k < count; ++k) {
+            vec3 offset;
+            do {
+                offset = vec3(random.range(-1.0f, 1.0f), random.range(-1.0f, 1.0f), random.range(-1.0f, 1.0f));
+            } while (dot(offset, offset) > 1.0f);
+            scene.addSphere(vec3(0.0f, 0.0f, -10.0f) + offset * 3.0f, 0.05f, k % 2 ? glossy : diffuse);
+        }
+    }
+    else if (kind == "lights") {
+        scene.addObject(new Plane(-2.0f, diffuse));
+        for (int k = 0; k < 200; ++k) {
+            float radius = random.range(0.3f, 1.0f);
+            scene.addSphere(vec3(random.range(-20.0f, 20.0f), radius - 2.0f, random.range(-50.0f, -5.0f)), radius, k % 2 ? glossy : diffuse);
+        }
+        scene.lights.clear();
+        for (int k = 0; k < count; ++k) {
+            Light light(vec3(random.range(-20.0f, 20.0f), random.range(-1.5f, 2.0f), random.range(-50.0f, -5.0f)));
+            light.color = vec3(random.next(), random.next(), random.next()) * 0.5f;
+            light.range = random.range(1.0f, 3.0f);
+            scene.lights.push_back(light);
+        }
+    }
+    else {
+        for (int k = 0; k < count; ++k) {
+            vec3 center(random.range(-40.0f, 40.0f), random.range(-20.0f, -3.0f), random.range(-60.0f, -5.0f));
+            scene.addSphere(center, random.range(0.2f, 1.0f), k % 2 ? glossy : diffuse);
+        }
+    }
+}
+
+// ⺻  ϳ calls ȣϴ ð ϴ.  ̸  ΰ  ϴ.
+template <class Call>
+BenchResult benchMicro(const std::string& name, long long calls, Call call) {
+    BenchResult result = { "micro", name, 0, 0, 0, 1, calls, 0.0, 1.0 };
+    result.seconds = benchBest([&]() {
+        for (long long k = 0; k < calls; ++k) {
+            call(static_cast<int>(k));
+        }
+    });
+    return result;
+}
+
+void writeBenchCSV(std::ostream& out, const std::vector<BenchResult>& results) {
+    out << "benchmark,name,objects,width,height,threads,rays,seconds,mrays_per_s,ns_per_ray,efficiency\n";
+    for (const BenchResult& r : results) {
+        out << r.benchmark << "," << r.name << "," << r.objects << "," << r.width << "," << r.height << "," << r.threads << ","
+            << r.rays << "," << r.seconds << ",";
+        if (r.rays > 0) {
+            out << r.rays / r.seconds * 1e-6 << "," << r.seconds * 1e9 / r.rays;
+        }
+        else {
+            out << ",";
+        }
+        out << "," << r.efficiency << "\n";
+    }
+}
+
+void writeBenchJSON(std::ostream& out, const std::vector<BenchResult>& results) {
+    out << "{\n  \"packets\": " << (UsePacketTracing ? "true" : "false")
+        << ",\n  \"samples\": " << OutputAntiAliasing.base_samples << ",\n  \"results\": [\n";
+    for (size_t k = 0; k < results.size(); ++k) {
+        const BenchResult& r = results[k];
+        out << "    {\"benchmark\": \"" << r.benchmark << "\", \"name\": \"" << r.name << "\", \"objects\": " << r.objects
+            << ", \"width\": " << r.width << ", \"height\": " << r.height << ", \"threads\": " << r.threads
+            << ", \"rays\": " << r.rays << ", \"seconds\": " << r.seconds;
+        if (r.rays > 0) {
+            out << ", \"mrays_per_s\": " << r.rays / r.seconds * 1e-6 << ", \"ns_per_ray\": " << r.seconds * 1e9 / r.rays;
+        }
+        out << ", \"efficiency\": " << r.efficiency << "}" << (k + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+//     ű  renderDirty() ü   ̹  Ȯմϴ.
+//   BVH prim_ids Ƿ,  ű  ڸ ٽ ߴ θ  · Ĩϴ.
+//   ( ǥ ̸  ͸)  ϰ ġ ʴ ̸   ϴ.
+bool checkSnapshotEdit(const Camera& camera, const std::string& report_path) {
+    std::string prefix = report_path.empty() ? std::string("bench-edit") : report_path + ".edit";
+    std::string path;
+    for (int n = 0; path.empty(); ++n) {
+        std::string candidate = prefix + (n > 0 ? "-" + std::to_string(n) : std::string()) + ".snap";
+        if (!std::ifstream(candidate)) {
+            path = candidate;
+        }
+    }
+    Scene source(camera, vec3(-10.0f, 30.0f, 10.0f));
+    buildBenchScene("field", 1000, source);
+    bool loaded = false;
+    bool same = true;
+    if (writeSceneSnapshot(path, source)) {
+        MappedFile file;
+        Scene scene(camera, vec3(-10.0f, 30.0f, 10.0f));
+        loaded = file.open(path) && loadSceneSnapshot(path, file, scene);
+        if (loaded) {
+            FrameDependencies.enabled = true;
+            render(scene);
+            float radius = scene.spheres.radius[0];
+            scene.moveSphere(0, scene.spheres.center(0) + vec3(radius, 0.0f, 0.0f), radius);
+            renderDirty(scene);
+            Framebuffer edited = OutputImage;
+            render(scene);
+            for (int j = 0; j < Height; ++j) {
+                for (int i = 0; i < Width; ++i) {
+                    same = same && edited.at(i, j) == OutputImage.at(i, j);
+                }
+            }
+            FrameDependencies.enabled = false;
+            FrameDependencies.invalidate();
+        }
+    }
+    std::remove(path.c_str());
+    if (loaded && !same) {
+        std::cerr << "Edit check failed: renderDirty() after moving a sphere of a loaded snapshot differs from render()" << std::endl;
+    }
+    return loaded && same;
+}
+
+// ġũ ü մϴ. path   CSV ǥ ¿ , ƴϸ Ȯ(.json Ǵ .csv)  Ϸ ϴ.
+bool runBenchmarks(const std::string& path) {
+    std::vector<BenchResult> results;
+    bool to_file = !path.empty();
+    auto report = [&](const BenchResult& r) {
+        results.push_back(r);
+        if (to_file) {
+            std::cout << r.benchmark << " " << r.name;
+            if (r.width > 0) {
+                std::cout << " " << r.width << "x" << r.height << " x" << r.threads;
+            }
+            std::cout << ": " << r.seconds * 1e3 << " ms";
+            if (r.rays > 0) {
+                std::cout << ", " << r.rays / r.seconds * 1e-6 << " Mrays/s";
+            }
+            std::cout << std::endl;
+        }
+    };
+
+    // ũκġũ
+    const int RAY_COUNT = 4096; // 2 ŵ (k & (RAY_COUNT - 1)  )
+    const long long CALLS = 1 << 22;
+    Width = Height = 512;
+    Camera camera(vec3(0, 0, 0), vec3(1, 0, 0), vec3(0, 1, 0), vec3(0, 0, 1), -0.1f, 0.1f, -0.1f, 0.1f, 0.1f);
+    std::vector<Ray> rays;
+    BenchRandom random(1);
+    for (int k = 0; k < RAY_COUNT; ++k) {
+        rays.push_back(camera.getRay(random.range(0.0f, 512.0f), random.range(0.0f, 512.0f)));
+    }
+    Sphere sphere(vec3(0, 0, -7), 2.0f, 0);
+    Plane plane(-2.0f, 0);
+    volatile float sink = 0.0f; //    ȣ ° ȭ  
+    float t;
+    report(benchMicro("Sphere::intersect", CALLS, [&](int k) {
+        if (sphere.intersect(rays[k & (RAY_COUNT - 1)], t)) {
+            sink = t;
+        }
+    }));
+    report(benchMicro("Plane::intersect", CALLS, [&](int k) {
+        if (plane.intersect(rays[k & (RAY_COUNT - 1)], t)) {
+            sink = t;
+        }
+    }));
+    report(benchMicro("Camera::getRay", CALLS, [&](int k) {
+        sink = camera.getRay(static_cast<float>(k & 511), static_cast<float>((k >> 9) & 511)).direction.x;
+    }));
+
+    //  ġũ  ΰ   鿡 ´ ̹   Ȯ
+    if (!checkSnapshotEdit(camera, path)) {
+        return false;
+    }
+
+    // ܰ : 鸶 ػ󵵿   ٲ  
+    struct BenchScene {
+        const char* kind;
+        int count;
+    };
+    const BenchScene scenes[] = {
+        { "field", 10 }, { "field", 100 }, { "field", 1000 }, { "field", 10000 }, { "field", 100000 }, { "field", 1000000 },
+        { "cluster", 100000 }, { "sky", 1000 }, { "lights", 10 }, { "lights", 1000 }
+    };
+    const int resolutions[] = { 256, 512, 1024 };
+    std::vector<int> thread_counts;
+    int max_threads = renderThreadCount();
+    for (int threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+    int saved_threads = NumThreads;
+
+    for (const BenchScene& bench_scene : scenes) {
+        Scene scene(camera, vec3(-10.0f, 30.0f, 10.0f));
+        buildBenchScene(bench_scene.kind, bench_scene.count, scene);
+        std::string name = std::string(bench_scene.kind) + "-" + std::to_string(bench_scene.count);
+        auto start = std::chrono::steady_clock::now();
+        scene.buildAccel();
+        BenchResult build = { "build", name, bench_scene.count, 0, 0, 1, 0,
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 1.0 };
+        report(build);
+        for (int resolution : resolutions) {
+            Width = Height = resolution;
+            double single_thread = 0.0;
+            for (int threads : thread_counts) {
+                NumThreads = threads;
+                long long traced = 0;
+                BenchResult r = { "render", name, bench_scene.count, Width, Height, threads, 0, 0.0, 1.0 };
+                r.seconds = benchBest([&]() {
+                    traced = render(scene);
+                });
+                r.rays = traced;
+                if (threads == 1) {
+                    single_thread = r.seconds;
+                }
+                r.efficiency = single_thread / (threads * r.seconds);
+                report(r);
+            }
+            //  ٲ : ִ   G-buffer ä   ó ٽ 
+            if (!OutputAntiAliasing.enabled()) {
+                PrimaryGBuffer.enabled = true;
+                render(scene);
+                BenchResult r = { "reshade", name, bench_scene.count, Width, Height, NumThreads, 0, 0.0, 1.0 }; // 1   
+                r.seconds = benchBest([&]() {
+                    reshade(scene);
+                });
+                PrimaryGBuffer.enabled = false;
+                PrimaryGBuffer.invalidate();
+                report(r);
+            }
+            //  ϳ ű :   ġ ̰ų ׸ڰ  Ÿϸ ٽ 
+            if (!OutputAntiAliasing.enabled() && scene.spheres.size() > 0) {
+                FrameDependencies.enabled = true;
+                render(scene);
+                vec3 center = scene.spheres.center(0);
+                float radius = scene.spheres.radius[0];
+                int moves = 0;
+                long long traced = 0;
+                BenchResult r = { "edit", name, bench_scene.count, Width, Height, NumThreads, 0, 0.0, 1.0 };
+                r.seconds = benchBest([&]() {
+                    scene.moveSphere(0, center + vec3(++moves % 2 ? radius : 0.0f, 0.0f, 0.0f), radius); // ڸ ŭ  
+                    traced = renderDirty(scene);
+                });
+                r.rays = traced;
+                scene.moveSphere(0, center, radius);
+                FrameDependencies.enabled = false;
+                FrameDependencies.invalidate();
+                report(r);
+            }
+        }
+    }
+    NumThreads = saved_threads;
+
+    if (!to_file) {
+        writeBenchCSV(std::cout, results);
+        return true;
+    }
+    std::ofstream file(path.c_str());
+    if (!file) {
+        std::cerr << "Cannot open " << path << " for writing" << std::endl;
+        return false;
+    }
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    if (json) {
+        writeBenchJSON(file, results);
+    }
+    else {
+        writeBenchCSV(file, results);
+    }
+    return static_cast<bool>(file);
+}
+
+// -------------------------------------------------
+//  ɼ
+
+struct Options {
+    bool headless;       // â OpenGL   Ϸ 
+    std::string output;  //  ̹ 
+    std::string scene;   //    ( ⺻ )
+    std::string snapshot; //     (  )
+    bool bench;           // ġũ ϰ 
+    std::string bench_output; // ġũ   (.csv Ǵ .json,  ǥ ¿ CSV)
+    std::string stats;    //   JSON  (RENDER_STATS  )
+    std::string trace;    // Chrome trace_event JSON  (RENDER_STATS  )
+    std::string heatmap;  // ȼ  Ʈ ̹  (--headless )
+    bool help;            //  ϰ 
+
+    Options() : headless(false), output("output.png"), bench(false), help(false) {}
+};
+
+void printUsage(std::ostream& out, const char* program) {
+    out << "Usage: " << program << " [options]\n"
+        << "  --help, -h          print this help and exit\n"
+        << "  --scene <file>      load the scene from a text scene file or a scene snapshot instead of the built-in one\n"
+        << "  --save-snapshot <file>  build the acceleration structure, save the scene as a snapshot and exit\n"
+        << "  --headless          render without a window and write the image to a file\n"
+        << "  --bench             run the benchmark suite and write CSV to stdout\n"
+        << "  --bench-out <file>  with --bench, write the results to the file instead: CSV, or JSON for .json\n"
+        << "  --stats <file>      write render counters and stage times as JSON on exit (RENDER_STATS builds)\n"
+        << "  --trace <file>      write a Chrome trace_event timeline of tiles and stages on exit (RENDER_STATS builds)\n"
+        << "  --width <pixels>    image width (default " << Width << ")\n"
+        << "  --height <pixels>   image height (default " << Height << ")\n"
+        << "  --output <file>     output image for --headless: .ppm, .pfm or .png (default output.png)\n"
+        << "  --heatmap <file>    with --headless, also write a color-mapped per-pixel cost image (.pfm keeps raw costs)\n"
+        << "  --heatmap-metric <m>  cost per pixel: time (nanoseconds) or steps (intersection tests + BVH nodes, RENDER_STATS builds)\n"
+        << "  --threads <count>   render threads (default: all cores)\n"
+        << "  --no-packets        trace primary rays one at a time instead of 2x2 packets\n"
+        << "  --wavefront         render final frames stage by stage over frame-wide ray queues (not with --samples > 1)\n"
+        << "  --samples <count>   stratified samples per pixel and per adaptive round; 1 disables anti-aliasing (default 1)\n"
+        << "  --max-samples <count>  per-pixel sample cap for adaptive anti-aliasing (default " << OutputAntiAliasing.max_samples << ")\n"
+        << "  --aa-threshold <t>  stop sampling once the standard error of the pixel luminance is below t (default " << OutputAntiAliasing.threshold << ")\n"
+        << "  --filter <filter>   reconstruction filter: box, tent or gaussian (default tent)\n"
+        << "  --exposure <scale>  multiply linear colors before tone mapping (default 1)\n"
+        << "  --tonemap <op>      none, reinhard or aces (default none)\n"
+        << "  --srgb              encode with the sRGB curve instead of gamma 2.2\n"
+        << "  --present <format>  window upload format: rgba8 or half (default rgba8)\n";
+}
+
+//   ɼ  нϴ.  ڰ ƴϰų 0 ̸ false ȯϰ value ״ Ӵϴ.
+bool parseCount(const char* text, int& value) {
+    char* end = nullptr;
+    errno = 0;
+    long parsed = std::strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || parsed <= 0 || parsed > INT_MAX) {
+        return false;
+    }
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+// Ǽ ɼ  нϴ.  ڰ ƴϰų  ʰų minimum  false ȯմϴ.
+bool parseNumber(const char* text, float minimum, float& value) {
+    char* end = nullptr;
+    float parsed = std::strtof(text, &end);
+    if (end == text || *end != '\0' || !std::isfinite(parsed) || parsed < minimum) {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+// ɼ ؼմϴ. ߸ ɼ̳ ̸  ϰ false ȯմϴ.
+// --help  ǥ ¿  options.help  ä true ȯմϴ ( ɼ  ).
+bool parseOptions(int argc, char** argv, Options& options) {
+    auto invalid = [&](const std::string& option, const char* value) {
+        std::cerr << "Invalid value for " << option << ": " << value << std::endl;
+        printUsage(std::cerr, argv[0]);
+        return false;
+    };
+    for (int k = 1; k < argc; ++k) {
+        std::string arg = argv[k];
+        bool has_value = k + 1 < argc;
+        if (arg == "--help" || arg == "-h") {
+            printUsage(std::cout, argv[0]);
+            options.help = true;
+            return true;
+        }
+        else if (arg == "--headless") {
+            options.headless = true;
+        }
+        else if (arg == "--bench") {
+            options.bench = true;
+        }
+        else if (arg == "--bench-out" && has_value) {
+            options.bench_output = argv[++k];
+        }
+        else if (arg == "--width" && has_value) {
+            if (!parseCount(argv[++k], Width)) {
+                return invalid(arg, argv[k]);
+            }
+        }
+        else if (arg == "--height" && has_value) {
+            if (!parseCount(argv[++k], Height)) {
+                return invalid(arg, argv[k]);
+            }
+        }
+        else if (arg == "--scene" && has_value) {
+            options.scene = argv[++k];
+        }
+        else if (arg == "--save-snapshot" && has_value) {
+            options.snapshot = argv[++k];
+        }
+        else if (arg == "--stats" && has_value) {
+            options.stats = argv[++k];
+        }
+        else if (arg == "--trace" && has_value) {
+            options.trace = argv[++k];
+        }
+        else if (arg == "--output" && has_value) {
+            options.output = argv[++k];
+        }
+        else if (arg == "--heatmap" && has_value) {
+            options.heatmap = argv[++k];
+        }
+        else if (arg == "--heatmap-metric" && has_value) {
+            std::string metric = argv[++k];
+            if (metric == "time") {
+                PixelCostMetric = CostMetric::Time;
+            }
+            else if (metric == "steps") {
+                PixelCostMetric = CostMetric::Steps;
+            }
+            else {
+                std::cerr << "Unknown heatmap metric: " << metric << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--threads" && has_value) {
+            if (!parseCount(argv[++k], NumThreads)) {
+                return invalid(arg, argv[k]);
+            }
+        }
+        else if (arg == "--no-packets") {
+            UsePacketTracing = false;
+        }
+        else if (arg == "--wavefront") {
+            UseWavefront = true;
+        }
+        else if (arg == "--samples" && has_value) {
+            if (!parseCount(argv[++k], OutputAntiAliasing.base_samples)) {
+                return invalid(arg, argv[k]);
+            }
+        }
+        else if (arg == "--max-samples" && has_value) {
+            if (!parseCount(argv[++k], OutputAntiAliasing.max_samples)) {
+                return invalid(arg, argv[k]);
+            }
+        }
+        else if (arg == "--aa-threshold" && has_value) {
+            if (!parseNumber(argv[++k], 0.0f, OutputAntiAliasing.threshold)) {
+                return invalid(arg, argv[k]);
+            }
+        }
+        else if (arg == "--filter" && has_value) {
+            std::string filter = argv[++k];
+            if (filter == "box") {
+                OutputAntiAliasing.filter = PixelFilter::Box;
+            }
+            else if (filter == "tent") {
+                OutputAntiAliasing.filter = PixelFilter::Tent;
+            }
+            else if (filter == "gaussian") {
+                OutputAntiAliasing.filter = PixelFilter::Gaussian;
+            }
+            else {
+                std::cerr << "Unknown reconstruction filter: " << filter << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--exposure" && has_value) {
+            if (!parseNumber(argv[++k], 0.0f, OutputToneMapper.exposure)) {
+                return invalid(arg, argv[k]);
+            }
+        }
+        else if (arg == "--tonemap" && has_value) {
+            std::string op = argv[++k];
+            if (op == "none") {
+                OutputToneMapper.tone_operator = ToneOperator::None;
+            }
+            else if (op == "reinhard") {
+                OutputToneMapper.tone_operator = ToneOperator::Reinhard;
+            }
+            else if (op == "aces") {
+                OutputToneMapper.tone_operator = ToneOperator::ACES;
+            }
+            else {
+                std::cerr << "Unknown tone mapping operator: " << op << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--srgb") {
+            OutputToneMapper.srgb = true;
+        }
+        else if (arg == "--present" && has_value) {
+            std::string format = argv[++k];
+            if (format == "rgba8") {
+                OutputPresentFormat = PresentFormat::RGBA8;
+            }
+            else if (format == "half") {
+                OutputPresentFormat = PresentFormat::Half;
+            }
+            else {
+                std::cerr << "Unknown present format: " << format << std::endl;
+                return false;
+            }
+        }
+        else {
+            printUsage(std::cerr, argv[0]);
+            return false;
+        }
+    }
+#if !RENDER_STATS
+    if (!options.stats.empty() || !options.trace.empty()) {
+        std::cerr << "--stats and --trace need a build with RENDER_STATS=1" << std::endl;
+        return false;
+    }
+    if (PixelCostMetric == CostMetric::Steps) {
+        std::cerr << "--heatmap-metric steps needs a build with RENDER_STATS=1" << std::endl;
+        return false;
+    }
+#endif
+    if (!options.bench_output.empty() && !options.bench) {
+        std::cerr << "--bench-out needs --bench" << std::endl;
+        return false;
+    }
+    if (!options.heatmap.empty() && !options.headless) {
+        std::cerr << "--heatmap needs --headless" << std::endl;
+        return false;
+    }
+    if (!options.heatmap.empty() && UseWavefront) {
+        std::cerr << "--heatmap cannot be combined with --wavefront (pixels are not traced one at a time)" << std::endl;
+        return false;
+    }
+    RecordPixelCost = !options.heatmap.empty();
+    if (OutputAntiAliasing.max_samples < OutputAntiAliasing.grid() * OutputAntiAliasing.grid()) {
+        std::cerr << "--max-samples must be at least one round of samples" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return -1;
+    }
+    if (options.help) {
+        return 0;
+    }
+    if (options.bench) {
+        return runBenchmarks(options.bench_output) ? 0 : -1;
+    }
+
+    // --stats, --trace  ( 尡   ڿ ȣ)
+    auto exportStats = [&options]() {
+#if RENDER_STATS
+        return (options.stats.empty() || writeStatsJSON(options.stats)) && (options.trace.empty() || writeChromeTrace(options.trace));
+#else
+        return true;
+#endif
+    };
+
+    // -------------------------------------------------
+    // Scene Setup
+    // -------------------------------------------------
+    Camera camera(vec3(0, 0, 0), vec3(1, 0, 0), vec3(0, 1, 0), vec3(0, 0, 1),
+        -0.1f, 0.1f, -0.1f, 0.1f, 0.1f);
+
+    MappedFile scene_file; //   迭 Ű  (scene   ߿ )
+    Scene scene(camera, vec3(-4.0f, 4.0f, -3.0f)); //  ġ
+
+    if (!options.scene.empty()) {
+        STAT_SCOPE("load scene");
+        auto start = std::chrono::steady_clock::now();
+        if (!loadSceneFile(options.scene, scene, scene_file)) {
+            return -1;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Loaded " << options.scene << " (" << scene.spheres.size() << " spheres, "
+            << scene.objects.size() << " other surfaces) in " << ms << " ms" << std::endl;
+    }
+    else {
+        // Material properties from the prompt
+        int plane_mat = scene.addMaterial(Material(vec3(0.2f, 0.2f, 0.2f), vec3(1.0f, 1.0f, 1.0f), vec3(0.0f, 0.0f, 0.0f), 0.0f));
+        int sphere1_mat = scene.addMaterial(Material(vec3(0.2f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, 0.0f), 0.0f));
+        int sphere2_mat = scene.addMaterial(Material(vec3(0.0f, 0.2f, 0.0f), vec3(0.0f, 0.5f, 0.0f), vec3(0.5f, 0.5f, 0.5f), 32.0f));
+        int sphere3_mat = scene.addMaterial(Material(vec3(0.0f, 0.0f, 0.2f), vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 0.0f, 0.0f), 0.0f));
+
+        scene.addObject(new Plane(-2.0f, plane_mat));
+        scene.addSphere(vec3(-4, 0, -7), 1.0f, sphere1_mat);
+        scene.addSphere(vec3(0, 0, -7), 2.0f, sphere2_mat);
+        scene.addSphere(vec3(4, 0, -7), 1.0f, sphere3_mat);
+    }
+
+    if (!options.snapshot.empty()) {
+        auto start = std::chrono::steady_clock::now();
+        if (!writeSceneSnapshot(options.snapshot, scene)) {
+            return -1;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Saved scene snapshot " << options.snapshot << " in " << ms << " ms" << std::endl;
+        return 0;
+    }
+
+    // -------------------------------------------------
+    // Headless: GLFW OpenGL   ʰ   Ϸ 
+    // -------------------------------------------------
+    if (options.headless) {
+        auto start = std::chrono::steady_clock::now();
+        long long samples = render(scene);
+        OutputToneMapper.apply(OutputImage, DisplayImage);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!writeImage(options.output)) {
+            std::cerr << "Failed to write " << options.output << std::endl;
+            return -1;
+        }
+        std::cout << "Rendered " << Width << "x" << Height << " in " << ms << " ms";
+        if (OutputAntiAliasing.enabled()) {
+            std::cout << " (" << static_cast<double>(samples) / (static_cast<double>(Width) * Height) << " samples/pixel)";
+        }
+        std::cout << " -> " << options.output << std::endl;
+        if (!options.heatmap.empty()) {
+            float scale;
+            if (!writeHeatmap(options.heatmap, scale)) {
+                std::cerr << "Failed to write " << options.heatmap << std::endl;
+                return -1;
+            }
+            std::cout << "Heatmap 0.." << scale << (PixelCostMetric == CostMetric::Time ? " ns" : " steps")
+                << " per pixel (99th percentile) -> " << options.heatmap << std::endl;
+        }
+        return exportStats() ? 0 : -1;
+    }
 
-int main(int argc, char* argv) {
     // -------------------------------------------------
     // Initialize Window
     // -------------------------------------------------
@@ -257,6 +5339,10 @@ int main(int argc, char* argv) {
 
     /* Make the window's context current */
     glfwMakeContextCurrent(window);
+    if (glewInit() != GLEW_OK) {
+        glfwTerminate();
+        return -1;
+    }
 
     // We have an opengl context now. Everything from here on out 
     // is just managing our window or opengl directly.
@@ -272,26 +5358,16 @@ int main(int argc, char* argv) {
     glfwSetFramebufferSizeCallback(window, resize_callback);
     resize_callback(NULL, Width, Height);
 
-    // -------------------------------------------------
-    // Scene Setup
-    // -------------------------------------------------
-    Camera camera(vec3(0, 0, 0), vec3(1, 0, 0), vec3(0, 1, 0), vec3(0, 0, 1),
-        -0.1f, 0.1f, -0.1f, 0.1f, 0.1f);
-
-    // Material properties from the prompt
-    Material plane_mat(vec3(0.2f, 0.2f, 0.2f), vec3(1.0f, 1.0f, 1.0f), vec3(0.0f, 0.0f, 0.0f), 0.0f);
-    Material sphere1_mat(vec3(0.2f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, 0.0f), 0.0f);
-    Material sphere2_mat(vec3(0.0f, 0.2f, 0.0f), vec3(0.0f, 0.5f, 0.0f), vec3(0.5f, 0.5f, 0.5f), 32.0f);
-    Material sphere3_mat(vec3(0.0f, 0.0f, 0.2f), vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 0.0f, 0.0f), 0.0f);
-
-    Scene scene(camera, vec3(-4.0f, 4.0f, -3.0f)); //  ġ
-    scene.addObject(new Plane(-2.0f, plane_mat));
-    scene.addObject(new Sphere(vec3(-4, 0, -7), 1.0f, sphere1_mat));
-    scene.addObject(new Sphere(vec3(0, 0, -7), 2.0f, sphere2_mat));
-    scene.addObject(new Sphere(vec3(4, 0, -7), 1.0f, sphere3_mat));
+    // â  ʵ  ׶忡  մϴ.
+    ProgressiveRenderer renderer(scene);
+    glfwSetWindowUserPointer(window, &renderer);
+    glfwSetKeyCallback(window, key_callback);
+    PrimaryGBuffer.enabled = true; //  ű ٽ  ʰ  ٽ 
+    renderer.start();
 
-    OutputImage.resize(Width * Height); // OutputImage ũ 
-    render(scene);
+    Presenter presenter;
+    presenter.init();
+    unsigned shown_frames = 0; // ȭ鿡 ø ̹ frameCount()
 
     /* Loop until the user closes the window */
     while (!glfwWindowShouldClose(window)) {
@@ -300,7 +5376,17 @@ int main(int argc, char* argv) {
 
         // -------------------------------------------------------------
         // Rendering begins!
-        glDrawPixels(Width, Height, GL_RGB, GL_FLOAT, &OutputImage[0]);
+        // ۾ 尡 н  frameCount() ٲ ӿ εմϴ. Ű Է  ª ۾
+        //   isRunning()    ȣ ٲ Ƿ  ̹ ġ ʽϴ.
+        bool rendering = renderer.isRunning(); // frameCount()  о 
+        unsigned frames = renderer.frameCount();
+        if (frames != shown_frames) {
+            shown_frames = frames;
+            renderer.withDisplay([&presenter](const Framebuffer& display) {
+                presenter.upload(display);
+            });
+        }
+        presenter.draw();
         // and ends.
         // -------------------------------------------------------------
 
@@ -308,7 +5394,14 @@ int main(int argc, char* argv) {
         glfwSwapBuffers(window);
 
         /* Poll for and process events */
-        glfwPollEvents();
+        //  ߿ κ ̹  ֵ ª  ݺϰ,   ̺Ʈ ϴ.
+        if (rendering) {
+            glfwPollEvents();
+            std::this_thread::sleep_for(std::chrono::milliseconds(16));
+        }
+        else {
+            glfwWaitEvents();
+        }
 
         // Close when the user hits 'q' or escape
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS ||
@@ -317,7 +5410,9 @@ int main(int argc, char* argv) {
         }
     }
 
+    renderer.cancel();
+    presenter.release();
     glfwDestroyWindow(window);
     glfwTerminate();
-    return 0;
+    return exportStats() ? 0 : -1;
 }
\ No newline at end of file